@@ -0,0 +1,35 @@
+/*
+ *  Copyright 2015 Wesley Lo
+ */
+
+#include "MyBlend.h"
+#include "MyBlendKernels.h"
+
+#define MY_BLEND_MODES(M) \
+	M(kClear), M(kSrc), M(kDst), M(kSrcOver), M(kDstOver), M(kSrcIn), M(kDstIn), M(kSrcOut), M(kDstOut), \
+	M(kSrcATop), M(kDstATop), M(kXor), M(kMultiply), M(kScreen), M(kDarken), M(kLighten), M(kDifference), \
+	M(kExclusion)
+
+#define MY_BLEND_ROW(mode) blendRow<MyBlendMode::mode>
+#define MY_BLEND_COLOR(mode) blendColor<MyBlendMode::mode>
+#define MY_BLEND_PIXEL(mode) blendPixel<MyBlendMode::mode>
+
+// Indexed by MyBlendMode, in declaration order
+static const MyBlendRowProc gRowProcs[] = { MY_BLEND_MODES(MY_BLEND_ROW) };
+static const MyBlendColorProc gColorProcs[] = { MY_BLEND_MODES(MY_BLEND_COLOR) };
+static GPixel (* const gPixelProcs[])(GPixel, GPixel) = { MY_BLEND_MODES(MY_BLEND_PIXEL) };
+
+static_assert(sizeof(gRowProcs) / sizeof(gRowProcs[0]) == (int) MyBlendMode::kLastMode + 1,
+		"one kernel per blend mode");
+
+MyBlendRowProc MyBlend_RowProc(MyBlendMode mode) {
+	return gRowProcs[(int) mode];
+}
+
+MyBlendColorProc MyBlend_ColorProc(MyBlendMode mode) {
+	return gColorProcs[(int) mode];
+}
+
+GPixel MyBlend_Pixel(MyBlendMode mode, GPixel src, GPixel dst) {
+	return gPixelProcs[(int) mode](src, dst);
+}
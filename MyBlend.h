@@ -0,0 +1,63 @@
+/*
+ *  Copyright 2015 Wesley Lo
+ */
+
+#ifndef MyBlend_DEFINED
+#define MyBlend_DEFINED
+
+#include "GPixel.h"
+
+/**
+ *  How a premultiplied source pixel S is combined with the destination pixel D (Sa and Da are
+ *  their alphas, and all values are in [0, 1]). The Porter-Duff modes come first, followed by
+ *  the separable modes, which combine each color channel on its own; their alpha is always
+ *  Sa + Da - Sa * Da.
+ */
+enum class MyBlendMode {
+	kClear,      // 0
+	kSrc,        // S
+	kDst,        // D
+	kSrcOver,    // S + D * (1 - Sa)
+	kDstOver,    // D + S * (1 - Da)
+	kSrcIn,      // S * Da
+	kDstIn,      // D * Sa
+	kSrcOut,     // S * (1 - Da)
+	kDstOut,     // D * (1 - Sa)
+	kSrcATop,    // S * Da + D * (1 - Sa)
+	kDstATop,    // D * Sa + S * (1 - Da)
+	kXor,        // S * (1 - Da) + D * (1 - Sa)
+
+	kMultiply,   // S * (1 - Da) + D * (1 - Sa) + S * D
+	kScreen,     // S + D - S * D
+	kDarken,     // S + D - max(S * Da, D * Sa)
+	kLighten,    // S + D - min(S * Da, D * Sa)
+	kDifference, // S + D - 2 * min(S * Da, D * Sa)
+	kExclusion,  // S + D - 2 * S * D
+
+	kLastMode = kExclusion
+};
+
+/**
+ *  dst_row[i] = mode(src_row[i], dst_row[i]) for i in [0, count)
+ */
+typedef void (*MyBlendRowProc)(GPixel dst_row[], const GPixel src_row[], int count);
+
+/**
+ *  dst_row[i] = mode(color, dst_row[i]) for i in [0, count)
+ */
+typedef void (*MyBlendColorProc)(GPixel dst_row[], GPixel color, int count);
+
+/**
+ *  The row kernels for a mode. Each mode has its own compile time specialization, with a lowp
+ *  AVX2 loop (16 pixels at a time) when available and a scalar loop giving the same results.
+ */
+MyBlendRowProc MyBlend_RowProc(MyBlendMode);
+
+MyBlendColorProc MyBlend_ColorProc(MyBlendMode);
+
+/**
+ *  Blend a single pixel.
+ */
+GPixel MyBlend_Pixel(MyBlendMode, GPixel src, GPixel dst);
+
+#endif
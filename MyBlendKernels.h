@@ -0,0 +1,213 @@
+/*
+ *  Copyright 2015 Wesley Lo
+ */
+
+#ifndef MyBlendKernels_DEFINED
+#define MyBlendKernels_DEFINED
+
+#include <algorithm>
+#include <cstring>
+#include "MyBlend.h"
+#include "MyLowp.h"
+
+/**
+ *  The blend kernels behind MyBlend_RowProc() and MyBlend_ColorProc(), as templates over the
+ *  mode. Include this (instead of calling through the procs) to inline a kernel into a loop
+ *  that is itself specialized for the mode, as the pipeline's blitters do.
+ */
+
+// Divide by 255, rounding, for x in [0, 255 * 255]
+static inline unsigned div255(unsigned x) {
+	return ((x + 128) * 257) >> 16;
+}
+
+// SRC_OVER for premultiplied pixels: result = src + dst * (1 - src_a)
+static inline GPixel srcOver(GPixel src, GPixel dst) {
+	unsigned src_a = GPixel_GetA(src);
+	if (src_a == 255)
+		return src;
+	if (src_a == 0)
+		return dst;
+
+	unsigned inv_a = 255 - src_a;
+	return GPixel_PackARGB(src_a + div255(GPixel_GetA(dst) * inv_a),
+			GPixel_GetR(src) + div255(GPixel_GetR(dst) * inv_a),
+			GPixel_GetG(src) + div255(GPixel_GetG(dst) * inv_a),
+			GPixel_GetB(src) + div255(GPixel_GetB(dst) * inv_a));
+}
+
+// One channel of mode(S, D); isAlpha picks the alpha formula of the separable modes.
+// The mode is a template argument, so each instantiation folds down to a single formula.
+template <MyBlendMode mode, bool isAlpha>
+static inline unsigned blendChannel(unsigned s, unsigned d, unsigned sa, unsigned da) {
+	unsigned result = 0;
+	switch (mode) {
+	case MyBlendMode::kClear:      result = 0; break;
+	case MyBlendMode::kSrc:        result = s; break;
+	case MyBlendMode::kDst:        result = d; break;
+	case MyBlendMode::kSrcOver:    result = s + div255(d * (255 - sa)); break;
+	case MyBlendMode::kDstOver:    result = d + div255(s * (255 - da)); break;
+	case MyBlendMode::kSrcIn:      result = div255(s * da); break;
+	case MyBlendMode::kDstIn:      result = div255(d * sa); break;
+	case MyBlendMode::kSrcOut:     result = div255(s * (255 - da)); break;
+	case MyBlendMode::kDstOut:     result = div255(d * (255 - sa)); break;
+	case MyBlendMode::kSrcATop:    result = div255(s * da) + div255(d * (255 - sa)); break;
+	case MyBlendMode::kDstATop:    result = div255(d * sa) + div255(s * (255 - da)); break;
+	case MyBlendMode::kXor:        result = div255(s * (255 - da)) + div255(d * (255 - sa)); break;
+	case MyBlendMode::kMultiply:   result = div255(s * (255 - da)) + div255(d * (255 - sa)) + div255(s * d); break;
+	case MyBlendMode::kScreen:     result = s + d - div255(s * d); break;
+	case MyBlendMode::kDarken:     result = s + d - std::max(div255(s * da), div255(d * sa)); break;
+	case MyBlendMode::kLighten:    result = s + d - std::min(div255(s * da), div255(d * sa)); break;
+	case MyBlendMode::kDifference:
+		result = isAlpha ? s + d - div255(s * d) : s + d - 2 * std::min(div255(s * da), div255(d * sa));
+		break;
+	case MyBlendMode::kExclusion:
+		result = isAlpha ? s + d - div255(s * d) : s + d - 2 * div255(s * d);
+		break;
+	}
+	// Only out of range for pixels that aren't properly premultiplied
+	return std::min(result, 255u);
+}
+
+template <MyBlendMode mode>
+static inline GPixel blendPixel(GPixel src, GPixel dst) {
+	if (mode == MyBlendMode::kSrcOver)
+		return srcOver(src, dst);
+
+	unsigned sa = GPixel_GetA(src);
+	unsigned da = GPixel_GetA(dst);
+	return GPixel_PackARGB(blendChannel<mode, true>(sa, da, sa, da),
+			blendChannel<mode, false>(GPixel_GetR(src), GPixel_GetR(dst), sa, da),
+			blendChannel<mode, false>(GPixel_GetG(src), GPixel_GetG(dst), sa, da),
+			blendChannel<mode, false>(GPixel_GetB(src), GPixel_GetB(dst), sa, da));
+}
+
+#ifdef __AVX2__
+// s * d / 255, rounded, per 16 bit lane
+static inline __m256i mul255(__m256i s, __m256i d) {
+	return MyLowp_Div255(_mm256_mullo_epi16(s, d));
+}
+
+// blendChannel() for 16 lanes, with the same rounding
+template <MyBlendMode mode, bool isAlpha>
+static inline __m256i blendLanes(__m256i s, __m256i d, __m256i sa, __m256i da) {
+	const __m256i full = _mm256_set1_epi16(255);
+	const __m256i invSa = _mm256_sub_epi16(full, sa);
+	const __m256i invDa = _mm256_sub_epi16(full, da);
+	__m256i result = _mm256_setzero_si256();
+	switch (mode) {
+	case MyBlendMode::kClear:      break;
+	case MyBlendMode::kSrc:        result = s; break;
+	case MyBlendMode::kDst:        result = d; break;
+	case MyBlendMode::kSrcOver:    result = _mm256_add_epi16(s, mul255(d, invSa)); break;
+	case MyBlendMode::kDstOver:    result = _mm256_add_epi16(d, mul255(s, invDa)); break;
+	case MyBlendMode::kSrcIn:      result = mul255(s, da); break;
+	case MyBlendMode::kDstIn:      result = mul255(d, sa); break;
+	case MyBlendMode::kSrcOut:     result = mul255(s, invDa); break;
+	case MyBlendMode::kDstOut:     result = mul255(d, invSa); break;
+	case MyBlendMode::kSrcATop:    result = _mm256_add_epi16(mul255(s, da), mul255(d, invSa)); break;
+	case MyBlendMode::kDstATop:    result = _mm256_add_epi16(mul255(d, sa), mul255(s, invDa)); break;
+	case MyBlendMode::kXor:        result = _mm256_add_epi16(mul255(s, invDa), mul255(d, invSa)); break;
+	case MyBlendMode::kMultiply:
+		result = _mm256_add_epi16(_mm256_add_epi16(mul255(s, invDa), mul255(d, invSa)), mul255(s, d));
+		break;
+	case MyBlendMode::kScreen:
+		result = _mm256_sub_epi16(_mm256_add_epi16(s, d), mul255(s, d));
+		break;
+	case MyBlendMode::kDarken:
+		result = _mm256_sub_epi16(_mm256_add_epi16(s, d), _mm256_max_epu16(mul255(s, da), mul255(d, sa)));
+		break;
+	case MyBlendMode::kLighten:
+		result = _mm256_sub_epi16(_mm256_add_epi16(s, d), _mm256_min_epu16(mul255(s, da), mul255(d, sa)));
+		break;
+	case MyBlendMode::kDifference:
+		if (isAlpha) {
+			result = _mm256_sub_epi16(_mm256_add_epi16(s, d), mul255(s, d));
+		} else {
+			__m256i m = _mm256_min_epu16(mul255(s, da), mul255(d, sa));
+			result = _mm256_sub_epi16(_mm256_add_epi16(s, d), _mm256_add_epi16(m, m));
+		}
+		break;
+	case MyBlendMode::kExclusion:
+		if (isAlpha) {
+			result = _mm256_sub_epi16(_mm256_add_epi16(s, d), mul255(s, d));
+		} else {
+			__m256i m = mul255(s, d);
+			result = _mm256_sub_epi16(_mm256_add_epi16(s, d), _mm256_add_epi16(m, m));
+		}
+		break;
+	}
+	return _mm256_min_epu16(result, full);
+}
+
+template <MyBlendMode mode>
+static inline MyLowp16 blend16(const MyLowp16& s, const MyLowp16& d) {
+	MyLowp16 result;
+	result.a = blendLanes<mode, true>(s.a, d.a, s.a, d.a);
+	result.r = blendLanes<mode, false>(s.r, d.r, s.a, d.a);
+	result.g = blendLanes<mode, false>(s.g, d.g, s.a, d.a);
+	result.b = blendLanes<mode, false>(s.b, d.b, s.a, d.a);
+	return result;
+}
+#endif
+
+template <MyBlendMode mode>
+static inline void blendRow(GPixel dst_row[], const GPixel src_row[], int count) {
+	if (mode == MyBlendMode::kDst)
+		return;
+	if (mode == MyBlendMode::kSrc) {
+		memcpy(dst_row, src_row, count * sizeof(GPixel));
+		return;
+	}
+	if (mode == MyBlendMode::kClear) {
+		std::fill_n(dst_row, count, 0);
+		return;
+	}
+
+	int i = 0;
+
+#ifdef __AVX2__
+	const __m256i alphaMask = _mm256_set1_epi32(0xFF << GPIXEL_SHIFT_A);
+	for (; i + 16 <= count; i += 16) {
+		if (mode == MyBlendMode::kSrcOver) {
+			__m256i lo = _mm256_loadu_si256((const __m256i*) &src_row[i]);
+			__m256i hi = _mm256_loadu_si256((const __m256i*) &src_row[i + 8]);
+			__m256i alphas = _mm256_or_si256(_mm256_and_si256(lo, alphaMask), _mm256_and_si256(hi, alphaMask));
+			if (_mm256_testz_si256(alphas, alphas))
+				continue; // all transparent
+			if (_mm256_testc_si256(_mm256_and_si256(lo, hi), alphaMask)) {
+				// all opaque
+				_mm256_storeu_si256((__m256i*) &dst_row[i], lo);
+				_mm256_storeu_si256((__m256i*) &dst_row[i + 8], hi);
+				continue;
+			}
+		}
+		MyLowp_Store16(&dst_row[i], blend16<mode>(MyLowp_Load16(&src_row[i]), MyLowp_Load16(&dst_row[i])));
+	}
+#endif
+
+	for (; i < count; ++i) {
+		dst_row[i] = blendPixel<mode>(src_row[i], dst_row[i]);
+	}
+}
+
+template <MyBlendMode mode>
+static inline void blendColor(GPixel dst_row[], GPixel color, int count) {
+	unsigned src_a = GPixel_GetA(color);
+	if (mode == MyBlendMode::kDst || (mode == MyBlendMode::kSrcOver && src_a == 0))
+		return;
+	if (mode == MyBlendMode::kClear || mode == MyBlendMode::kSrc || (mode == MyBlendMode::kSrcOver && src_a == 255)) {
+		std::fill_n(dst_row, count, mode == MyBlendMode::kClear ? 0 : color);
+		return;
+	}
+
+	// Blend a row of the color, a chunk at a time, so every mode gets its vector loop
+	const int kChunkSize = 64;
+	GPixel chunk[kChunkSize];
+	std::fill_n(chunk, std::min(count, kChunkSize), color);
+	for (int i = 0; i < count; i += kChunkSize) {
+		blendRow<mode>(&dst_row[i], chunk, std::min(count - i, kChunkSize));
+	}
+}
+
+#endif
@@ -2,7 +2,14 @@
  *  Copyright 2015 Wesley Lo
  */
 
+#include <algorithm>
 #include "MyCanvas.h"
+#include "MyHairline.h"
+#include "MyMatrix.h"
+#include "MyMipmap.h"
+#include "MyRasterizer.h"
+#include "MyShaderFromTriangle.h"
+#include "MyStroker.h"
 
 Edge::Edge(float yMax, float xMin, float mReciprocal, Edge* next) {
 	this->yMax = yMax;
@@ -28,6 +35,7 @@ void MyCanvas::clear(const GColor& color) {
 	int r = color.fR < 0 ? 0 : color.fR * fA;
 	int g = color.fG < 0 ? 0 : color.fG * fA;
 	int b = color.fB < 0 ? 0 : color.fB * fA;
+	willDraw();
 
 	GPixel* row = dst.pixels();
 	for (int y = 0; y < dst.height(); ++y) {
@@ -39,45 +47,7 @@ void MyCanvas::clear(const GColor& color) {
 	}
 }
 
-void MyCanvas::fillPoint(GPoint point, GPixel pixel) {
-	int dst_x = floor(point.fX + 0.5);
-	int dst_y = floor(point.fY + 0.5);
-
-	if (dst_x < 0 || dst_x >= dst.fWidth || dst_y < 0 || dst_y >= dst.fHeight)
-		return;
-
-	float src_a_01 = GPixel_GetA(pixel) / 255.0;
-	float src_r = GPixel_GetR(pixel);
-	float src_g = GPixel_GetG(pixel);
-	float src_b = GPixel_GetB(pixel);
-
-	GPixel* dst_row = dst.pixels();
-	for (int i = 0; i < dst_y; ++i) {
-		dst_row += dst.rowBytes() >> 2;
-	}
-
-	float dst_a_01 = GPixel_GetA(dst_row[dst_x]) / 255.0;
-	float dst_r = GPixel_GetR(dst_row[dst_x]);
-	float dst_g = GPixel_GetG(dst_row[dst_x]);
-	float dst_b = GPixel_GetB(dst_row[dst_x]);
-
-	float blend_a_01 = src_a_01 + (dst_a_01 * (1 - src_a_01));
-	unsigned blend_a = blend_a_01 * 255;
-	float blend_r = blend_a == 0 ? 0 : ((src_r * src_a_01) + ((dst_r * dst_a_01) * (1 - src_a_01))) / blend_a_01;
-	float blend_g = blend_a == 0 ? 0 : ((src_g * src_a_01) + ((dst_g * dst_a_01) * (1 - src_a_01))) / blend_a_01;
-	float blend_b = blend_a == 0 ? 0 : ((src_b * src_a_01) + ((dst_b * dst_a_01) * (1 - src_a_01))) / blend_a_01;
-
-	if (round(blend_r) > blend_a)
-		blend_r = blend_a;
-	if (round(blend_g) > blend_a)
-		blend_g = blend_a;
-	if (round(blend_b) > blend_a)
-		blend_b = blend_a;
-
-	dst_row[dst_x] = GPixel_PackARGB(round(blend_a), round(blend_r), round(blend_g), round(blend_b));
-}
-
-void MyCanvas::fillLine(float x1, float x2, int y, const GColor& color) {
+void MyCanvas::fillLine(float x1, float x2, int y, MyPipeline& pipeline) {
 	int left = floor(x1 + 0.5);
 	int right = floor(x2 + 0.5);
 
@@ -90,184 +60,122 @@ void MyCanvas::fillLine(float x1, float x2, int y, const GColor& color) {
 	if (right >= dst.fWidth)
 		right = dst.fWidth;
 
-	float src_a_01 = color.fA < 0 ? 0 : color.fA;
-	float src_r = color.fR < 0 ? 0 : color.fR * 255;
-	float src_g = color.fG < 0 ? 0 : color.fG * 255;
-	float src_b = color.fB < 0 ? 0 : color.fB * 255;
-
-	GPixel* dst_row = dst.pixels();
-	for (int i = 0; i < y; ++i) {
-		dst_row += dst.rowBytes() >> 2;
-	}
-
-	for (int dst_x = left; dst_x < right; ++dst_x) {
-		float dst_a_01 = GPixel_GetA(dst_row[dst_x]) / 255.0;
-		float dst_r = GPixel_GetR(dst_row[dst_x]);
-		float dst_g = GPixel_GetG(dst_row[dst_x]);
-		float dst_b = GPixel_GetB(dst_row[dst_x]);
-
-		float blend_a_01 = src_a_01 + (dst_a_01 * (1 - src_a_01));
-		unsigned blend_a = blend_a_01 * 255;
-		float blend_r = blend_a == 0 ? 0 : ((src_r * src_a_01) + ((dst_r * dst_a_01) * (1 - src_a_01))) / blend_a_01;
-		float blend_g = blend_a == 0 ? 0 : ((src_g * src_a_01) + ((dst_g * dst_a_01) * (1 - src_a_01))) / blend_a_01;
-		float blend_b = blend_a == 0 ? 0 : ((src_b * src_a_01) + ((dst_b * dst_a_01) * (1 - src_a_01))) / blend_a_01;
-
-		if (round(blend_r) > blend_a)
-			blend_r = blend_a;
-		if (round(blend_g) > blend_a)
-			blend_g = blend_a;
-		if (round(blend_b) > blend_a)
-			blend_b = blend_a;
-
-		dst_row[dst_x] = GPixel_PackARGB(round(blend_a), round(blend_r), round(blend_g), round(blend_b));
-	}
-}
-
-void MyCanvas::fillLine(float x1, float x2, int y, GShader* shader) {
-	int left = floor(x1 + 0.5);
-	int right = floor(x2 + 0.5);
-
-	if (y < 0 || y >= dst.fHeight)
+	if (left >= right)
 		return;
 
-	if (left < 0)
-		left = 0;
-
-	if (right >= dst.fWidth)
-		right = dst.fWidth;
-
-	GPixel* dst_row = dst.pixels();
-	for (int i = 0; i < y; ++i) {
-		dst_row += dst.rowBytes() >> 2;
-	}
-
-	shader->setContext(ctm);
-	shader->shadeRow(left, y, right - left + 1, dst_row);
+	pipeline.run(left, y, right - left);
 }
 
-void MyCanvas::fillStroke(float x1, float x2, int y, GShader* shader) {
-	int left = floor(x1 + 0.5);
-	int right = floor(x2 + 0.5);
+void MyCanvas::fillRect(const GRect& rect, const GColor& color) {
+	int left = std::max(0, (int) floor(rect.fLeft + 0.5));
+	int top = std::max(0, (int) floor(rect.fTop + 0.5));
+	int right = std::min(dst.fWidth, (int) floor(rect.fRight + 0.5));
+	int bottom = std::min(dst.fHeight, (int) floor(rect.fBottom + 0.5));
 
-	if (y < 0 || y >= dst.fHeight)
-		return;
+	willDraw();
+	MyPipeline pipeline(dst, color, blendMode);
+	setupPipeline(pipeline);
+	pipeline.runRect(left, top, right, bottom);
+}
 
-	if (left < 0)
-		left = 0;
+void MyCanvas::fillBitmapRect(const GBitmap& src, const GRect& rect) {
+	// Map the bitmap onto the rect and let the bitmap shader do the (inverse) sampling
+	const float localMatrix[6] = {
+		rect.width() / src.width(), 0, rect.left(),
+		0, rect.height() / src.height(), rect.top(),
+	};
+	MyShaderFromBitmap shader(src, localMatrix, filterQuality);
+
+	// The shader only lives for this draw, so baking it would only evict entries worth keeping
+	bool caching = shaderCaching;
+	shaderCaching = false;
+	shadeRect(rect, &shader);
+	shaderCaching = caching;
+}
 
-	if (right >= dst.fWidth)
-		right = dst.fWidth;
+void MyCanvas::setFilterQuality(MyShaderFromBitmap::FilterQuality quality) {
+	filterQuality = quality;
+}
 
-	GPixel* dst_row = dst.pixels();
-	for (int i = 0; i < y; ++i) {
-		dst_row += dst.rowBytes() >> 2;
-	}
-	dst_row = dst_row + (unsigned int) left;
+void MyCanvas::setBlendMode(MyBlendMode mode) {
+	blendMode = mode;
+}
 
-	shader->setContext(ctm);
-	shader->shadeRow(0, y, right - left + 1, dst_row);
+void MyCanvas::setAlpha(float alpha) {
+	this->alpha = alpha;
 }
 
-void MyCanvas::fillRect(const GRect& rect, const GColor& color) {
-	int left = floor(rect.fLeft + 0.5);
-	int top = floor(rect.fTop + 0.5);
-	int right = floor(rect.fRight + 0.5);
-	int bottom = floor(rect.fBottom + 0.5);
-
-	float src_a_01 = color.fA < 0 ? 0 : color.fA;
-	float src_r = color.fR < 0 ? 0 : color.fR * 255;
-	float src_g = color.fG < 0 ? 0 : color.fG * 255;
-	float src_b = color.fB < 0 ? 0 : color.fB * 255;
-
-	GPixel* dst_row = dst.pixels();
-
-	for (int dst_y = 0; dst_y < dst.height(); ++dst_y) {
-		for (int dst_x = 0; dst_x < dst.width(); ++dst_x) {
-			if (dst_x >= left && dst_x < right && dst_y >= top && dst_y < bottom) {
-				float dst_a_01 = GPixel_GetA(dst_row[dst_x]) / 255.0;
-				float dst_r = GPixel_GetR(dst_row[dst_x]);
-				float dst_g = GPixel_GetG(dst_row[dst_x]);
-				float dst_b = GPixel_GetB(dst_row[dst_x]);
-
-				float blend_a_01 = src_a_01 + (dst_a_01 * (1 - src_a_01));
-				unsigned blend_a = blend_a_01 * 255;
-				float blend_r = blend_a == 0 ? 0 : ((src_r * src_a_01) + ((dst_r * dst_a_01) * (1 - src_a_01))) / blend_a_01;
-				float blend_g = blend_a == 0 ? 0 : ((src_g * src_a_01) + ((dst_g * dst_a_01) * (1 - src_a_01))) / blend_a_01;
-				float blend_b = blend_a == 0 ? 0 : ((src_b * src_a_01) + ((dst_b * dst_a_01) * (1 - src_a_01))) / blend_a_01;
-
-				dst_row[dst_x] = GPixel_PackARGB(round(blend_a), round(blend_r), round(blend_g), round(blend_b));
-			}
-		}
-		// Advance dst_row pointer to the next row
-		dst_row += dst.rowBytes() >> 2;
-	}
+void MyCanvas::setColorMatrix(const MyColorMatrix* colorMatrix) {
+	this->colorMatrix = colorMatrix;
 }
 
-void MyCanvas::fillBitmapRect(const GBitmap& src, const GRect& rectUntransformed) {
-	GRect rect;
-	bool rotated = ctm[1] != 0.0 || ctm[3] != 0.0;
-	float loop_increment = 1;
-
-	if (rotated) {
-		rect.fLeft = rectUntransformed.fLeft;
-		rect.fTop = rectUntransformed.fTop;
-		rect.fRight = rectUntransformed.fRight;
-		rect.fBottom = rectUntransformed.fBottom;
-		loop_increment = 0.4;
-	} else {
-		transformRect(rectUntransformed, rect);
-	}
+void MyCanvas::setShaderCaching(bool caching) {
+	shaderCaching = caching;
+}
 
-	int left = floor(rect.fLeft + 0.5);
-	int top = floor(rect.fTop + 0.5);
-	int right = floor(rect.fRight + 0.5);
-	int bottom = floor(rect.fBottom + 0.5);
+void MyCanvas::setStrokeStyle(MyStroker::Join join, MyStroker::Cap cap) {
+	strokeJoin = join;
+	strokeCap = cap;
+}
 
-	GPixel* src_row = src.pixels();
-	int src_y_scaled = 0;
+void MyCanvas::setHairlineAntiAlias(bool antiAlias) {
+	hairlineAntiAlias = antiAlias;
+}
 
-	if (!rotated) {
-		if (top < 0) { 	// When the top of rect is off the canvas, we need to advance src_row pointer to the correct row
-			// Scale src height
-			src_y_scaled = (0 - top + 1) * src.height() / (bottom - top + 1);
-		} else { // Advance src_row pointer to the first scaled row
-			// Scale src height
-			src_y_scaled = 1 * src.height() / (bottom - top + 1);
-		}
+void MyCanvas::setDash(const float intervals[], int count, float phase) {
+	dash = MyDash(intervals, count, phase);
+}
 
-		// Advance src_row pointer to the correct row
-		src_row = src.pixels();
-		for (int z = 0; z < src_y_scaled; ++z) {
-			src_row += src.rowBytes() >> 2;
-		}
+GShader* MyCanvas::prepareShader(GShader* shader, int left, int top, int right, int bottom,
+		std::shared_ptr<const MyShaderCache>& baked) {
+	MyShader* myShader = dynamic_cast<MyShader*>(shader);
+	if (shaderCaching && myShader && left < right && top < bottom) {
+		baked = MyShaderCache::Find(myShader, ctm, left, top, right, bottom);
+		if (baked)
+			return baked->blitShader();
 	}
+	return shader->setContext(ctm) ? shader : NULL;
+}
 
-	for (float dst_y = top; dst_y < bottom; ++dst_y) {
-		for (float dst_x = left; dst_x < right; dst_x += loop_increment) {
-			GPoint pointUntransformed[1] = { dst_x, dst_y };
-			GPoint point[1] = { dst_x, dst_y };
+void MyCanvas::willDraw() {
+	// Mipmaps built from dst are about to go stale
+	MyMipmap::Purge(dst);
+}
 
-			if (rotated) {
-				transformPoints(pointUntransformed, point, 1);
-			}
+void MyCanvas::setupPipeline(MyPipeline& pipeline) {
+	pipeline.setAlpha(alpha);
+	if (colorMatrix)
+		colorMatrix->addStageTo(pipeline);
+}
 
-			// Scale src width
-			int src_x_scaled = (dst_x - left + 1) * src.width() / (right - left + 1);
+void MyCanvas::fillConvexPolygon(const GPoint points[], int count, const GColor& color) {
+	willDraw();
+	MyPipeline pipeline(dst, color, blendMode);
+	setupPipeline(pipeline);
+	scanConvexPolygon(points, count, pipeline);
+}
 
-			fillPoint(point[0], src_row[src_x_scaled]);
-		}
-		// Scale src height
-		src_y_scaled = (dst_y - top + 2) * src.height() / (bottom - top + 1);
+void MyCanvas::fillConvexPolygons(const GPoint points[], const int counts[], int polygonCount, const GColor colors[]) {
+	if (polygonCount <= 0)
+		return;
 
-		// Advance src_row pointer to the correct row
-		src_row = src.pixels();
-		for (int z = 0; z < src_y_scaled; ++z) {
-			src_row += src.rowBytes() >> 2;
-		}
+	willDraw();
+	MyRasterizer rasterizer(dst.fWidth, dst.fHeight, ctm);
+	std::vector<MyPipeline> pipelines;
+	pipelines.reserve(polygonCount);
+	for (int i = 0; i < polygonCount; ++i) {
+		rasterizer.setShape(i);
+		if (counts[i] >= 3)
+			rasterizer.addPolygon(points, counts[i]);
+		points += std::max(0, counts[i]);
+
+		pipelines.emplace_back(dst, colors[i], blendMode);
+		setupPipeline(pipelines.back());
 	}
+	rasterizer.fillShapes(pipelines.data());
 }
 
-void MyCanvas::fillConvexPolygon(const GPoint pointsUntransformed[], int count, const GColor& color) {
+void MyCanvas::scanConvexPolygon(const GPoint pointsUntransformed[], int count, MyPipeline& pipeline) {
 	// Polygon must have at least 3 points
 	if (count < 3)
 		return;
@@ -376,7 +284,7 @@ void MyCanvas::fillConvexPolygon(const GPoint pointsUntransformed[], int count,
 
 		if (activeEdgeTable != NULL) {
 			// Fill the line
-			fillLine(activeEdgeTable->xMin, activeEdgeTable->next->xMin, y, color);
+			fillLine(activeEdgeTable->xMin, activeEdgeTable->next->xMin, y, pipeline);
 
 			// Update x for all edges in active edge table
 			currPtr = activeEdgeTable;
@@ -424,384 +332,608 @@ void MyCanvas::restore() {
 }
 
 void MyCanvas::concat(const float matrix[6]) {
-	float concatMatrix[6];
-
 	// Matrix multiplication
 	// [ A B C ] [ a b c ]   [ Aa+Bd  Ab+Be  Ac+Bf+C ]
 	// [ D E F ]*[ d e f ] = [ Da+Ed  Db+Ee  Dc+Ef+F ]
 	// [ 0 0 1 ] [ 0 0 1 ]   [   0      0       1    ]
-
-	concatMatrix[0] = ctm[0] * matrix[0] + ctm[1] * matrix[3];
-	concatMatrix[1] = ctm[0] * matrix[1] + ctm[1] * matrix[4];
-	concatMatrix[2] = ctm[0] * matrix[2] + ctm[1] * matrix[5] + ctm[2];
-	concatMatrix[3] = ctm[3] * matrix[0] + ctm[4] * matrix[3];
-	concatMatrix[4] = ctm[3] * matrix[1] + ctm[4] * matrix[4];
-	concatMatrix[5] = ctm[3] * matrix[2] + ctm[4] * matrix[5] + ctm[5];
-
-	for (int i = 0; i < 6; ++i) {
-		ctm[i] = concatMatrix[i];
-	}
+	MyMatrix_Concat(ctm, matrix, ctm);
 }
 
 void MyCanvas::shadeRect(const GRect& rectUntransformed, GShader* shader) {
-	GRect rect;
-	bool rotated = ctm[1] != 0.0 || ctm[3] != 0.0;
-	bool scaled = ctm[0] != 1.0 || ctm[4] != 1.0;
-
-	if (rotated || !scaled) {
-		rect.fLeft = rectUntransformed.fLeft;
-		rect.fTop = rectUntransformed.fTop;
-		rect.fRight = rectUntransformed.fRight;
-		rect.fBottom = rectUntransformed.fBottom;
-	} else {
-		transformRect(rectUntransformed, rect);
+	if (!MyMatrix_IsAxisAligned(ctm)) {
+		// A rotated rect is just a convex quad in device space
+		GPoint quad[4];
+		quad[0] = GPoint::Make(rectUntransformed.fLeft, rectUntransformed.fTop);
+		quad[1] = GPoint::Make(rectUntransformed.fRight, rectUntransformed.fTop);
+		quad[2] = GPoint::Make(rectUntransformed.fRight, rectUntransformed.fBottom);
+		quad[3] = GPoint::Make(rectUntransformed.fLeft, rectUntransformed.fBottom);
+		shadeConvexPolygon(quad, 4, shader);
+		return;
 	}
 
-	int left = std::max(0, (int) floor(rect.fLeft + 0.5));
-	int top = std::max(0, (int) floor(rect.fTop + 0.5));
-	int right = std::min(dst.fWidth, (int) floor(rect.fRight + 0.5));
-	int bottom = std::min(dst.fHeight, (int) floor(rect.fBottom + 0.5));
+	GRect rect;
+	transformRect(rectUntransformed, rect);
+
+	// A negative scale flips the rect, so sort its edges
+	int left = std::max(0, (int) floor(std::min(rect.fLeft, rect.fRight) + 0.5));
+	int top = std::max(0, (int) floor(std::min(rect.fTop, rect.fBottom) + 0.5));
+	int right = std::min(dst.fWidth, (int) floor(std::max(rect.fLeft, rect.fRight) + 0.5));
+	int bottom = std::min(dst.fHeight, (int) floor(std::max(rect.fTop, rect.fBottom) + 0.5));
+
+	std::shared_ptr<const MyShaderCache> baked;
+	shader = prepareShader(shader, left, top, right, bottom, baked);
+	if (!shader)
+		return;
+
+	willDraw();
+	MyPipeline pipeline(dst, shader, blendMode);
+	setupPipeline(pipeline);
+	pipeline.runRect(left, top, right, bottom);
+}
+
+void MyCanvas::shadeConvexPolygon(const GPoint points[], int count, GShader* shader) {
+	// Polygon must have at least 3 points
+	if (count < 3)
+		return;
 
-	GPixel* dst_row = dst.pixels();
-	for (int z = 0; z < top; ++z) {
-		dst_row += dst.rowBytes() >> 2;
+	// The device pixels the polygon can touch
+	std::vector<GPoint> devicePoints(count);
+	transformPoints(points, devicePoints.data(), count);
+	float minX = devicePoints[0].fX, maxX = minX, minY = devicePoints[0].fY, maxY = minY;
+	for (int i = 1; i < count; ++i) {
+		minX = std::min(minX, devicePoints[i].fX);
+		maxX = std::max(maxX, devicePoints[i].fX);
+		minY = std::min(minY, devicePoints[i].fY);
+		maxY = std::max(maxY, devicePoints[i].fY);
 	}
+	int left = std::max(0, (int) floor(minX));
+	int top = std::max(0, (int) floor(minY));
+	int right = std::min(dst.fWidth, (int) ceil(maxX) + 1);
+	int bottom = std::min(dst.fHeight, (int) ceil(maxY) + 1);
+
+	std::shared_ptr<const MyShaderCache> baked;
+	shader = prepareShader(shader, left, top, right, bottom, baked);
+	if (!shader)
+		return;
 
-	for (int dst_y = top; dst_y < bottom; ++dst_y) {
-		GPixel src_row[1024];
-		shader->setContext(ctm);
-		shader->shadeRow(left, dst_y, right - left + 1, src_row);
+	willDraw();
+	MyPipeline pipeline(dst, shader, blendMode);
+	setupPipeline(pipeline);
+	scanConvexPolygon(points, count, pipeline);
+}
 
-		for (int i = left; i < right; ++i) {
-			GPoint pointUntransformed[1] = { i, dst_y };
-			GPoint point[1] = { i, dst_y };
+void MyCanvas::fillPath(const MyPath& path, const GColor& color) {
+	MyRasterizer rasterizer(dst.fWidth, dst.fHeight, ctm);
+	path.addTo(rasterizer);
 
-			if (rotated || !scaled) {
-				transformPoints(pointUntransformed, point, 1);
-			}
+	willDraw();
+	MyPipeline pipeline(dst, color, blendMode);
+	setupPipeline(pipeline);
+	rasterizer.fill(pipeline);
+}
 
-			fillPoint(point[0], src_row[i]);
-		}
+void MyCanvas::shadePath(const MyPath& path, GShader* shader) {
+	MyRasterizer rasterizer(dst.fWidth, dst.fHeight, ctm);
+	path.addTo(rasterizer);
+
+	int left, top, right, bottom;
+	if (!rasterizer.deviceBounds(&left, &top, &right, &bottom))
+		return;
+
+	std::shared_ptr<const MyShaderCache> baked;
+	shader = prepareShader(shader, left, top, right, bottom, baked);
+	if (!shader)
+		return;
+
+	willDraw();
+	MyPipeline pipeline(dst, shader, blendMode);
+	setupPipeline(pipeline);
+	rasterizer.fill(pipeline);
+}
+
+bool MyCanvas::mapOval(const GRect& rectUntransformed, DeviceOval& oval) {
+	GRect rect;
+	transformRect(rectUntransformed, rect);
+	oval.cx = (rect.fLeft + rect.fRight) / 2;
+	oval.cy = (rect.fTop + rect.fBottom) / 2;
+	oval.rx = fabsf(rect.fRight - rect.fLeft) / 2;
+	oval.ry = fabsf(rect.fBottom - rect.fTop) / 2;
+	if (!(oval.rx > 0 && oval.ry > 0))
+		return false;
+
+	// Rows whose centers are strictly inside the oval's top and bottom
+	oval.top = std::max(0, (int) floor(oval.cy - oval.ry - 0.5) + 1);
+	oval.bottom = std::min(dst.fHeight, (int) ceil(oval.cy + oval.ry - 0.5));
+	return oval.top < oval.bottom;
+}
 
-		dst_row += dst.rowBytes() >> 2;
+void MyCanvas::scanOval(const DeviceOval& oval, MyPipeline& pipeline) {
+	const float invRy = 1 / oval.ry;
+	for (int y = oval.top; y < oval.bottom; ++y) {
+		// The half width of the row at its center: rx * sqrt(1 - ((y - cy) / ry)^2)
+		float dy = (y + 0.5f - oval.cy) * invRy;
+		float halfWidth = oval.rx * sqrtf(std::max(0.0f, 1 - dy * dy));
+		int left = std::max(0, (int) floor(oval.cx - halfWidth + 0.5f));
+		int right = std::min(dst.fWidth, (int) floor(oval.cx + halfWidth + 0.5f));
+		if (left < right)
+			pipeline.run(left, y, right - left);
 	}
 }
 
-void MyCanvas::shadeConvexPolygon(const GPoint pointsUntransformed[], int count, GShader* shader) {
-	// Polygon must have at least 3 points
-	if (count < 3)
+void MyCanvas::fillOval(const GRect& rect, const GColor& color) {
+	if (!MyMatrix_IsAxisAligned(ctm)) {
+		fillPath(MyPath().addOval(rect), color);
 		return;
+	}
 
-	GPoint points[count];
-	transformPoints(pointsUntransformed, points, count);
+	DeviceOval oval;
+	if (!mapOval(rect, oval))
+		return;
 
-	float yMaxGlobal = round(points[0].fY);
-	float yMinGlobal = round(points[0].fY);
+	willDraw();
+	MyPipeline pipeline(dst, color, blendMode);
+	setupPipeline(pipeline);
+	scanOval(oval, pipeline);
+}
 
-	// Compute global edge table size and array offset
-	for (int i = 0; i < count; ++i) {
-		if (points[i].fY < yMinGlobal)
-			yMinGlobal = round(points[i].fY);
-		if (points[i].fY > yMaxGlobal)
-			yMaxGlobal = round(points[i].fY);
+void MyCanvas::shadeOval(const GRect& rect, GShader* shader) {
+	if (!MyMatrix_IsAxisAligned(ctm)) {
+		shadePath(MyPath().addOval(rect), shader);
+		return;
 	}
 
-	int globalEdgeTableSize = yMinGlobal < 0 ? yMaxGlobal - yMinGlobal + 1 : yMaxGlobal + 1;
-	int arrayOffset = yMinGlobal < 0 ? abs(yMinGlobal) : 0;
-	int y = yMinGlobal;
+	DeviceOval oval;
+	if (!mapOval(rect, oval))
+		return;
 
-	Edge* globalEdgeTable[globalEdgeTableSize];
-	Edge* activeEdgeTable = NULL;
-	Edge* prevPtr = NULL;
-	Edge* currPtr = NULL;
+	int left = std::max(0, (int) floor(oval.cx - oval.rx));
+	int right = std::min(dst.fWidth, (int) ceil(oval.cx + oval.rx) + 1);
+	if (left >= right)
+		return;
 
-	// Initialize global edge table
-	for (int i = 0; i < globalEdgeTableSize; ++i) {
-		globalEdgeTable[i] = NULL;
+	std::shared_ptr<const MyShaderCache> baked;
+	shader = prepareShader(shader, left, oval.top, right, oval.bottom, baked);
+	if (!shader)
+		return;
+
+	willDraw();
+	MyPipeline pipeline(dst, shader, blendMode);
+	setupPipeline(pipeline);
+	scanOval(oval, pipeline);
+}
+
+// Scale the radii down (all by the same factor) until the corners on each side fit along it
+static void fitRadii(const GRect& rect, const float radii[4], float fitted[4]) {
+	float width = fabsf(rect.fRight - rect.fLeft);
+	float height = fabsf(rect.fBottom - rect.fTop);
+	float scale = 1;
+	for (int i = 0; i < 4; ++i) {
+		fitted[i] = std::max(0.0f, radii[i]);
+	}
+	for (int i = 0; i < 4; ++i) {
+		// Corners i and i + 1 share a side: the top, right, bottom, then left
+		float side = i % 2 == 0 ? width : height;
+		float sum = fitted[i] + fitted[(i + 1) % 4];
+		if (sum > side)
+			scale = std::min(scale, side / sum);
 	}
+	for (int i = 0; i < 4; ++i) {
+		fitted[i] *= scale;
+	}
+}
 
-	// Create global edge table
-	for (int i = 0; i < count; ++i) {
-		if (points[(i + 1) % count].fY - points[i].fY != 0) { // slope != 0
-			float yMax = 0;
-			float yMin = 0;
-			float xMin = 0;
-			if (points[(i + 1) % count].fY > points[i].fY) {
-				yMax = round(points[(i + 1) % count].fY);
-				xMin = round(points[i].fX);
-				yMin = round(points[i].fY);
-			} else {
-				yMax = round(points[i].fY);
-				xMin = round(points[(i + 1) % count].fX);
-				yMin = round(points[(i + 1) % count].fY);
-			}
-			float mReciprocal = (points[(i + 1) % count].fX - points[i].fX) / (points[(i + 1) % count].fY - points[i].fY);
+// A rounded rect in device space: its sides, and the horizontal and vertical radius of each
+// corner (top left, top right, bottom right, bottom left)
+struct DeviceRRect {
+	float left, top, right, bottom;
+	float rx[4], ry[4];
+};
+
+// Map the rounded rect to device space by an axis aligned CTM
+static void mapRRect(const float ctm[6], const GRect& rect, const float radii[4], DeviceRRect& rrect) {
+	GPoint p0 = MyMatrix_MapPoint(ctm, rect.fLeft, rect.fTop);
+	GPoint p1 = MyMatrix_MapPoint(ctm, rect.fRight, rect.fBottom);
+	rrect.left = std::min(p0.fX, p1.fX);
+	rrect.right = std::max(p0.fX, p1.fX);
+	rrect.top = std::min(p0.fY, p1.fY);
+	rrect.bottom = std::max(p0.fY, p1.fY);
+
+	// A negative scale mirrors the corners too
+	const bool flipX = ctm[0] < 0;
+	const bool flipY = ctm[4] < 0;
+	for (int i = 0; i < 4; ++i) {
+		int right = (i == 1 || i == 2) != flipX;
+		int bottom = (i >= 2) != flipY;
+		int corner = bottom ? 3 - right : right;
+		rrect.rx[corner] = radii[i] * fabsf(ctm[0]);
+		rrect.ry[corner] = radii[i] * fabsf(ctm[4]);
+	}
+}
 
-			globalEdgeTable[(int) yMin + arrayOffset] = new Edge(yMax, xMin, mReciprocal, globalEdgeTable[(int) yMin + arrayOffset]);
-		}
+// How far the side of the rounded rect is in from its rect, at height y, between the corners
+// above (top) and below (bottom) on that side
+static inline float cornerInset(const DeviceRRect& rrect, float y, int top, int bottom) {
+	float dy;
+	int corner;
+	if (y < rrect.top + rrect.ry[top]) {
+		corner = top;
+		dy = rrect.top + rrect.ry[top] - y;
+	} else if (y > rrect.bottom - rrect.ry[bottom]) {
+		corner = bottom;
+		dy = y - (rrect.bottom - rrect.ry[bottom]);
+	} else {
+		return 0;
 	}
+	float t = dy / rrect.ry[corner];
+	return rrect.rx[corner] * (1 - sqrtf(std::max(0.0f, 1 - t * t)));
+}
 
-	do {
-		// Move edges to active edge table
-		while (globalEdgeTable[y + arrayOffset] != NULL) {
-			if (activeEdgeTable == NULL) {
-				activeEdgeTable = globalEdgeTable[y + arrayOffset];
-				globalEdgeTable[y + arrayOffset] = globalEdgeTable[y + arrayOffset]->next;
-				activeEdgeTable->next = NULL;
-			} else {
-				// If the xMin's on the current line are the same, compare the xMin's on the next line
-				float globalXMin = globalEdgeTable[y + arrayOffset]->xMin;
-				float activeXMin = activeEdgeTable->xMin;
-				if (globalXMin == activeEdgeTable->xMin) {
-					globalXMin += globalEdgeTable[y + arrayOffset]->mReciprocal;
-					activeXMin += activeEdgeTable->mReciprocal;
-				}
+// The span of the rounded rect along the row whose center is y; false if the row misses it
+static inline bool rrectSpan(const DeviceRRect& rrect, float y, float* left, float* right) {
+	if (!(y > rrect.top && y <= rrect.bottom))
+		return false;
+	*left = rrect.left + cornerInset(rrect, y, 0, 3);
+	*right = rrect.right - cornerInset(rrect, y, 1, 2);
+	return true;
+}
 
-				if (globalXMin < activeXMin) {
-					currPtr = activeEdgeTable;
-					activeEdgeTable = globalEdgeTable[y + arrayOffset];
-					globalEdgeTable[y + arrayOffset] = globalEdgeTable[y + arrayOffset]->next;
-					activeEdgeTable->next = currPtr;
-				} else {
-					prevPtr = activeEdgeTable;
-					currPtr = activeEdgeTable->next;
-					while (currPtr != NULL && globalEdgeTable[y + arrayOffset]->xMin >= currPtr->xMin) {
-						prevPtr = prevPtr->next;
-						currPtr = currPtr->next;
-					}
-					prevPtr->next = globalEdgeTable[y + arrayOffset];
-					globalEdgeTable[y + arrayOffset] = globalEdgeTable[y + arrayOffset]->next;
-					prevPtr->next->next = currPtr;
-				}
-			}
-		}
+// The rows [*top, *bottom) whose centers are clear of all four corners
+static void straightRows(const DeviceRRect& rrect, int* top, int* bottom) {
+	*top = (int) floor(rrect.top + std::max(rrect.ry[0], rrect.ry[1]) + 0.5f);
+	*bottom = (int) floor(rrect.bottom - std::max(rrect.ry[2], rrect.ry[3]) + 0.5f);
+}
 
-		// Remove finished edges
-		prevPtr = activeEdgeTable;
-		currPtr = activeEdgeTable;
-		while (currPtr != NULL) {
-			if ((int) round(currPtr->yMax) == y) {
-				if (activeEdgeTable == currPtr) {
-					activeEdgeTable = currPtr->next;
-					currPtr = currPtr->next;
-				} else {
-					prevPtr->next = currPtr->next;
-					currPtr = currPtr->next;
-				}
-			} else {
-				prevPtr = currPtr;
-				currPtr = currPtr->next;
-			}
+// Fill outer, less inner if it isn't NULL, clipped to width x height
+static void scanRRect(const DeviceRRect& outer, const DeviceRRect* inner, int width, int height,
+		MyPipeline& pipeline) {
+	const int top = std::max(0, (int) floor(outer.top + 0.5f));
+	const int bottom = std::min(height, (int) floor(outer.bottom + 0.5f));
+
+	// Rows where every side is straight are rects: the whole rect, or the two sides of a stroke
+	int bandTop, bandBottom;
+	straightRows(outer, &bandTop, &bandBottom);
+	if (inner) {
+		int innerTop, innerBottom;
+		straightRows(*inner, &innerTop, &innerBottom);
+		bandTop = std::max(bandTop, innerTop);
+		bandBottom = std::min(bandBottom, innerBottom);
+	}
+	bandTop = std::max(bandTop, top);
+	bandBottom = std::min(bandBottom, bottom);
+	if (bandTop >= bandBottom)
+		bandTop = bandBottom = bottom;
+
+	const int outerLeft = std::max(0, (int) floor(outer.left + 0.5f));
+	const int outerRight = std::min(width, (int) floor(outer.right + 0.5f));
+	if (bandTop < bandBottom) {
+		if (inner) {
+			int innerLeft = std::min(outerRight, (int) floor(inner->left + 0.5f));
+			int innerRight = std::max(outerLeft, (int) floor(inner->right + 0.5f));
+			if (outerLeft < innerLeft)
+				pipeline.runRect(outerLeft, bandTop, innerLeft, bandBottom);
+			if (innerRight < outerRight)
+				pipeline.runRect(innerRight, bandTop, outerRight, bandBottom);
+		} else if (outerLeft < outerRight) {
+			pipeline.runRect(outerLeft, bandTop, outerRight, bandBottom);
 		}
+	}
 
-		if (activeEdgeTable != NULL) {
-			// Fill the line
-			fillLine(activeEdgeTable->xMin, activeEdgeTable->next->xMin, y, shader);
+	// The corner rows, above and below the band
+	for (int y = top; y < bottom; ++y) {
+		if (y == bandTop) {
+			y = bandBottom - 1;
+			continue;
+		}
 
-			// Update x for all edges in active edge table
-			currPtr = activeEdgeTable;
-			while (currPtr != NULL) {
-				currPtr->xMin += currPtr->mReciprocal;
-				currPtr = currPtr->next;
+		float center = y + 0.5f;
+		float left, right, innerLeft, innerRight;
+		if (!rrectSpan(outer, center, &left, &right))
+			continue;
+		int x0 = std::max(0, (int) floor(left + 0.5f));
+		int x1 = std::min(width, (int) floor(right + 0.5f));
+		if (inner && rrectSpan(*inner, center, &innerLeft, &innerRight)) {
+			int hole0 = std::max(x0, (int) floor(innerLeft + 0.5f));
+			int hole1 = std::min(x1, (int) floor(innerRight + 0.5f));
+			if (hole0 < hole1) {
+				if (x0 < hole0)
+					pipeline.run(x0, y, hole0 - x0);
+				x0 = hole1;
 			}
-
-			// Go to next scan line
-			y++;
 		}
-	} while (activeEdgeTable != NULL);
+		if (x0 < x1)
+			pipeline.run(x0, y, x1 - x0);
+	}
 }
 
-void MyCanvas::shadeStrokePolygon(const GPoint pointsUntransformed[], int count, GShader* shader) {
-	// Polygon must have at least 3 points
-	if (count < 3)
+void MyCanvas::fillRRect(const GRect& rect, const float radii[4], const GColor& color) {
+	float fitted[4];
+	fitRadii(rect, radii, fitted);
+
+	willDraw();
+	MyPipeline pipeline(dst, color, blendMode);
+	setupPipeline(pipeline);
+	if (!MyMatrix_IsAxisAligned(ctm)) {
+		MyRasterizer rasterizer(dst.fWidth, dst.fHeight, ctm);
+		MyPath().addRRect(rect, fitted).addTo(rasterizer);
+		rasterizer.fill(pipeline);
 		return;
+	}
 
-	GPoint points[count];
-	transformPoints(pointsUntransformed, points, count);
+	DeviceRRect rrect;
+	mapRRect(ctm, rect, fitted, rrect);
+	scanRRect(rrect, NULL, dst.fWidth, dst.fHeight, pipeline);
+}
 
-	float yMaxGlobal = round(points[0].fY);
-	float yMinGlobal = round(points[0].fY);
+void MyCanvas::strokeRRect(const GRect& rect, const float radii[4], const Stroke& stroke, const GColor& color) {
+	if (!(stroke.fWidth > 0))
+		return;
 
-	// Compute global edge table size and array offset
-	for (int i = 0; i < count; ++i) {
-		if (points[i].fY < yMinGlobal)
-			yMinGlobal = round(points[i].fY);
-		if (points[i].fY > yMaxGlobal)
-			yMaxGlobal = round(points[i].fY);
+	// Sort the rect's sides, so growing and shrinking it go the right way
+	const float half = stroke.fWidth / 2;
+	const float l = std::min(rect.fLeft, rect.fRight), r = std::max(rect.fLeft, rect.fRight);
+	const float t = std::min(rect.fTop, rect.fBottom), b = std::max(rect.fTop, rect.fBottom);
+	const GRect outerRect = GRect::MakeLTRB(l - half, t - half, r + half, b + half);
+	const GRect innerRect = GRect::MakeLTRB(l + half, t + half, r - half, b - half);
+	const bool hasInner = innerRect.fLeft < innerRect.fRight && innerRect.fTop < innerRect.fBottom;
+
+	float fitted[4], outerRadii[4], innerRadii[4];
+	fitRadii(GRect::MakeLTRB(l, t, r, b), radii, fitted);
+	for (int i = 0; i < 4; ++i) {
+		outerRadii[i] = fitted[i] > 0 ? fitted[i] + half : 0;
+		innerRadii[i] = std::max(0.0f, fitted[i] - half);
 	}
 
-	int globalEdgeTableSize = yMinGlobal < 0 ? yMaxGlobal - yMinGlobal + 1 : yMaxGlobal + 1;
-	int arrayOffset = yMinGlobal < 0 ? abs(yMinGlobal) : 0;
-	int y = yMinGlobal;
+	willDraw();
+	MyPipeline pipeline(dst, color, blendMode);
+	setupPipeline(pipeline);
+	if (!MyMatrix_IsAxisAligned(ctm)) {
+		MyRasterizer rasterizer(dst.fWidth, dst.fHeight, ctm);
+		MyPath().addRRect(outerRect, outerRadii).addTo(rasterizer);
+		if (hasInner)
+			MyPath().addRRect(innerRect, innerRadii).addTo(rasterizer, true);
+		rasterizer.fill(pipeline);
+		return;
+	}
 
-	Edge* globalEdgeTable[globalEdgeTableSize];
-	Edge* activeEdgeTable = NULL;
-	Edge* prevPtr = NULL;
-	Edge* currPtr = NULL;
+	DeviceRRect outer, inner;
+	mapRRect(ctm, outerRect, outerRadii, outer);
+	if (hasInner)
+		mapRRect(ctm, innerRect, innerRadii, inner);
+	scanRRect(outer, hasInner ? &inner : NULL, dst.fWidth, dst.fHeight, pipeline);
+}
 
-	// Initialize global edge table
-	for (int i = 0; i < globalEdgeTableSize; ++i) {
-		globalEdgeTable[i] = NULL;
+// Run the pipeline over rows [top, bottom) between two edges, each given by a point on it and
+// its change in x per row
+static void scanTriangleRows(const GPoint& a, float aSlope, const GPoint& b, float bSlope, int top, int bottom,
+		int width, MyPipeline& pipeline) {
+	float xa = a.fX + (top + 0.5f - a.fY) * aSlope;
+	float xb = b.fX + (top + 0.5f - b.fY) * bSlope;
+	for (int y = top; y < bottom; ++y) {
+		int left = std::max(0, (int) floor(std::min(xa, xb) + 0.5f));
+		int right = std::min(width, (int) floor(std::max(xa, xb) + 0.5f));
+		if (left < right)
+			pipeline.run(left, y, right - left);
+		xa += aSlope;
+		xb += bSlope;
 	}
+}
 
-	// Create global edge table
-	for (int i = 0; i < count; ++i) {
-		if (points[(i + 1) % count].fY - points[i].fY != 0) { // slope != 0
-			float yMax = 0;
-			float yMin = 0;
-			float xMin = 0;
-			if (points[(i + 1) % count].fY > points[i].fY) {
-				yMax = round(points[(i + 1) % count].fY);
-				xMin = round(points[i].fX);
-				yMin = round(points[i].fY);
-			} else {
-				yMax = round(points[i].fY);
-				xMin = round(points[(i + 1) % count].fX);
-				yMin = round(points[(i + 1) % count].fY);
-			}
-			float mReciprocal = (points[(i + 1) % count].fX - points[i].fX) / (points[(i + 1) % count].fY - points[i].fY);
+// Fill the device space triangle, clipped to width x height, stepping its edges down the rows
+static void scanTriangle(const GPoint device[3], int width, int height, MyPipeline& pipeline) {
+	const GPoint* p[3] = { &device[0], &device[1], &device[2] };
+	if (p[1]->fY < p[0]->fY)
+		std::swap(p[0], p[1]);
+	if (p[2]->fY < p[1]->fY)
+		std::swap(p[1], p[2]);
+	if (p[1]->fY < p[0]->fY)
+		std::swap(p[0], p[1]);
+
+	// Rows whose centers are in [top, bottom) of the triangle, split at the middle corner
+	const int top = std::max(0, (int) ceil(p[0]->fY - 0.5f));
+	const int bottom = std::min(height, (int) ceil(p[2]->fY - 0.5f));
+	if (top >= bottom)
+		return;
+	const int middle = std::max(top, std::min(bottom, (int) ceil(p[1]->fY - 0.5f)));
 
-			globalEdgeTable[(int) yMin + arrayOffset] = new Edge(yMax, xMin, mReciprocal, globalEdgeTable[(int) yMin + arrayOffset]);
-		}
+	// A half only has rows if its corners are apart in y
+	const float longSlope = (p[2]->fX - p[0]->fX) / (p[2]->fY - p[0]->fY);
+	if (top < middle) {
+		float slope = (p[1]->fX - p[0]->fX) / (p[1]->fY - p[0]->fY);
+		scanTriangleRows(*p[0], longSlope, *p[0], slope, top, middle, width, pipeline);
+	}
+	if (middle < bottom) {
+		float slope = (p[2]->fX - p[1]->fX) / (p[2]->fY - p[1]->fY);
+		scanTriangleRows(*p[0], longSlope, *p[1], slope, middle, bottom, width, pipeline);
 	}
+}
 
-	do {
-		// Move edges to active edge table
-		while (globalEdgeTable[y + arrayOffset] != NULL) {
-			if (activeEdgeTable == NULL) {
-				activeEdgeTable = globalEdgeTable[y + arrayOffset];
-				globalEdgeTable[y + arrayOffset] = globalEdgeTable[y + arrayOffset]->next;
-				activeEdgeTable->next = NULL;
-			} else {
-				// If the xMin's on the current line are the same, compare the xMin's on the next line
-				float globalXMin = globalEdgeTable[y + arrayOffset]->xMin;
-				float activeXMin = activeEdgeTable->xMin;
-				if (globalXMin == activeEdgeTable->xMin) {
-					globalXMin += globalEdgeTable[y + arrayOffset]->mReciprocal;
-					activeXMin += activeEdgeTable->mReciprocal;
-				}
+// The vertices of triangle i of a mesh drawn as mode
+static void triangleVertices(MyCanvas::VertexMode mode, int i, int vertices[3]) {
+	switch (mode) {
+	case MyCanvas::kTriangles:
+		vertices[0] = i * 3;
+		vertices[1] = i * 3 + 1;
+		vertices[2] = i * 3 + 2;
+		break;
+	case MyCanvas::kTriangleStrip:
+		vertices[0] = i;
+		vertices[1] = i + 1;
+		vertices[2] = i + 2;
+		break;
+	case MyCanvas::kTriangleFan:
+		vertices[0] = 0;
+		vertices[1] = i + 1;
+		vertices[2] = i + 2;
+		break;
+	default:
+		// Not a mode: a degenerate triangle, which draws nothing
+		vertices[0] = vertices[1] = vertices[2] = 0;
+		break;
+	}
+}
 
-				if (globalXMin < activeXMin) {
-					currPtr = activeEdgeTable;
-					activeEdgeTable = globalEdgeTable[y + arrayOffset];
-					globalEdgeTable[y + arrayOffset] = globalEdgeTable[y + arrayOffset]->next;
-					activeEdgeTable->next = currPtr;
-				} else {
-					prevPtr = activeEdgeTable;
-					currPtr = activeEdgeTable->next;
-					while (currPtr != NULL && globalEdgeTable[y + arrayOffset]->xMin >= currPtr->xMin) {
-						prevPtr = prevPtr->next;
-						currPtr = currPtr->next;
-					}
-					prevPtr->next = globalEdgeTable[y + arrayOffset];
-					globalEdgeTable[y + arrayOffset] = globalEdgeTable[y + arrayOffset]->next;
-					prevPtr->next->next = currPtr;
-				}
-			}
+void MyCanvas::drawVertices(VertexMode mode, int count, const GPoint vertices[], const GColor colors[],
+		const GPoint texs[], GShader* shader) {
+	if (count < 3 || (!colors && !shader))
+		return;
+	if (!texs)
+		texs = vertices;
+
+	std::vector<GPoint> device(count);
+	transformPoints(vertices, device.data(), count);
+
+	// One shader and pipeline for the mesh; only the triangle they shade changes
+	MyShaderFromTriangle triangle(shader);
+	willDraw();
+	MyPipeline pipeline(dst, &triangle, blendMode);
+	setupPipeline(pipeline);
+
+	const int triangleCount = mode == kTriangles ? count / 3 : count - 2;
+	for (int i = 0; i < triangleCount; ++i) {
+		int index[3];
+		triangleVertices(mode, i, index);
+		const GPoint corners[3] = { device[index[0]], device[index[1]], device[index[2]] };
+		const GPoint cornerTexs[3] = { texs[index[0]], texs[index[1]], texs[index[2]] };
+		GColor cornerColors[3];
+		for (int j = 0; colors && j < 3; ++j) {
+			cornerColors[j] = colors[index[j]];
 		}
+		if (!triangle.setTriangle(corners, colors ? cornerColors : NULL, cornerTexs))
+			continue;
+		scanTriangle(corners, dst.fWidth, dst.fHeight, pipeline);
+	}
+}
 
-		// Remove finished edges
-		prevPtr = activeEdgeTable;
-		currPtr = activeEdgeTable;
-		while (currPtr != NULL) {
-			if ((int) round(currPtr->yMax) == y) {
-				if (activeEdgeTable == currPtr) {
-					activeEdgeTable = currPtr->next;
-					currPtr = currPtr->next;
-				} else {
-					prevPtr->next = currPtr->next;
-					currPtr = currPtr->next;
-				}
-			} else {
-				prevPtr = currPtr;
-				currPtr = currPtr->next;
-			}
-		}
+void MyCanvas::strokePolygon(const GPoint points[], int pointCount, bool isClosed, const Stroke& stroke, GShader* shader) {
+	// Line must have at least 2 points
+	if (pointCount < 2)
+		return;
 
-		if (activeEdgeTable != NULL) {
-			// Fill the line
-			fillStroke(activeEdgeTable->xMin, activeEdgeTable->next->xMin, y, shader);
+	if (!shader->setContext(ctm))
+		return;
 
-			// Update x for all edges in active edge table
-			currPtr = activeEdgeTable;
-			while (currPtr != NULL) {
-				currPtr->xMin += currPtr->mReciprocal;
-				currPtr = currPtr->next;
-			}
+	willDraw();
+	MyPipeline pipeline(dst, shader, blendMode);
+	setupPipeline(pipeline);
+	strokePolygon(points, pointCount, isClosed, stroke, pipeline);
+}
 
-			// Go to next scan line
-			y++;
-		}
-	} while (activeEdgeTable != NULL);
+void MyCanvas::strokePolygon(const GPoint points[], int pointCount, bool isClosed, const Stroke& stroke,
+		const GColor& color) {
+	willDraw();
+	MyPipeline pipeline(dst, color, blendMode);
+	setupPipeline(pipeline);
+	strokePolygon(points, pointCount, isClosed, stroke, pipeline);
 }
 
-void MyCanvas::strokePolygon(const GPoint points[], int pointCount, bool isClosed, const Stroke& stroke, GShader* shader) {
+void MyCanvas::strokeLine(const GPoint& p0, const GPoint& p1, const Stroke& stroke, const GColor& color) {
+	// Plots and wireframes draw many short lines, where building a pipeline for each would cost
+	// more than the line itself
+	GPixel pixel;
+	if (!dash.isValid() && !hairlineAntiAlias && alpha == 1 && !colorMatrix && stroke.fWidth >= 0
+			&& stroke.fWidth * MyMatrix_MaxScale(ctm) <= 1 && MyPipeline::SolidPixel(color, blendMode, &pixel)) {
+		willDraw();
+		const GPoint devicePoints[] = {
+			MyMatrix_MapPoint(ctm, p0.fX, p0.fY),
+			MyMatrix_MapPoint(ctm, p1.fX, p1.fY),
+		};
+		MyHairline_StrokeSolid(devicePoints, 2, false, stroke.fAddCap, dst, pixel);
+		return;
+	}
+
+	const GPoint points[] = { p0, p1 };
+	strokePolygon(points, 2, false, stroke, color);
+}
+
+void MyCanvas::strokeRect(const GRect& rect, const Stroke& stroke, const GColor& color) {
+	const GPoint points[] = {
+		GPoint::Make(rect.left(), rect.top()),
+		GPoint::Make(rect.right(), rect.top()),
+		GPoint::Make(rect.right(), rect.bottom()),
+		GPoint::Make(rect.left(), rect.bottom()),
+	};
+	strokePolygon(points, 4, true, stroke, color);
+}
+
+// The bounds, in the space ctm maps from, of the width x height device outset by pad pixels.
+// Returns false if ctm can't be inverted.
+static bool localBounds(const float ctm[6], int width, int height, float pad, GRect* bounds) {
+	float inverse[6];
+	if (!MyMatrix_Invert(ctm, inverse))
+		return false;
+
+	const GPoint corners[4] = {
+		MyMatrix_MapPoint(inverse, -pad, -pad),
+		MyMatrix_MapPoint(inverse, width + pad, -pad),
+		MyMatrix_MapPoint(inverse, width + pad, height + pad),
+		MyMatrix_MapPoint(inverse, -pad, height + pad),
+	};
+	*bounds = GRect::MakeLTRB(corners[0].fX, corners[0].fY, corners[0].fX, corners[0].fY);
+	for (int i = 1; i < 4; ++i) {
+		bounds->fLeft = std::min(bounds->fLeft, corners[i].fX);
+		bounds->fTop = std::min(bounds->fTop, corners[i].fY);
+		bounds->fRight = std::max(bounds->fRight, corners[i].fX);
+		bounds->fBottom = std::max(bounds->fBottom, corners[i].fY);
+	}
+	return true;
+}
+
+// What a dashed hairline needs to draw each dash
+struct HairlineDash {
+	const float* ctm;
+	bool addCap;
+	bool antiAlias;
+	const GBitmap* dst;
+	MyPipeline* pipeline;
+	std::vector<GPoint> devicePoints; // reused by every dash
+};
+
+static void StrokeHairlineDash(void* context, const GPoint pts[], int count, const GPoint&) {
+	HairlineDash* hairline = (HairlineDash*) context;
+	std::vector<GPoint>& devicePoints = hairline->devicePoints;
+	devicePoints.resize(count);
+	for (int i = 0; i < count; ++i) {
+		devicePoints[i] = MyMatrix_MapPoint(hairline->ctm, pts[i].fX, pts[i].fY);
+	}
+	MyHairline_Stroke(devicePoints.data(), count, false, hairline->addCap, hairline->antiAlias, hairline->dst->fWidth,
+			hairline->dst->fHeight, *hairline->pipeline);
+}
+
+void MyCanvas::strokePolygon(const GPoint points[], int pointCount, bool isClosed, const Stroke& stroke,
+		MyPipeline& pipeline) {
 	// Line must have at least 2 points
-	if (pointCount < 2)
+	if (pointCount < 2 || !(stroke.fWidth >= 0))
 		return;
 
-	GPoint notchPolygonPoints[4];
-	GPoint lastBevelPolygonPoint;
-	float prevX, prevY, prevLen, prevXPrime, prevYPrime = 0;
-	int loopCount = isClosed ? pointCount + 1 : pointCount - 1;
-	for (int i = 0; i < loopCount; ++i) {
-		float xA = points[i % pointCount].fX;
-		float yA = points[i % pointCount].fY;
-		float xB = points[(i + 1) % pointCount].fX;
-		float yB = points[(i + 1) % pointCount].fY;
-
-		// compute xPrime & yPrime for quad polygon
-		float x = xB - xA;
-		float y = yB - yA;
-		float len = sqrt(x * x + y * y);
-		float rad = stroke.fWidth / 2;
-		float xPrime = x * rad / len;
-		float yPrime = y * rad / len;
-
-		// adjust for end caps
-		if (stroke.fAddCap) {
-			xA -= xPrime;
-			yA -= yPrime;
-			xB += xPrime;
-			yB += yPrime;
-
-			// compute xPrime & yPrime for quad polygon again
-			x = xB - xA;
-			y = yB - yA;
-			len = sqrt(x * x + y * y);
-			rad = stroke.fWidth / 2;
-			xPrime = x * rad / len;
-			yPrime = y * rad / len;
-		}
+	// Dashes off the device (by more than their caps and antialiasing could reach) are skipped
+	GRect bounds;
+	const GRect* dashBounds = NULL;
+	if (dash.isValid() && localBounds(ctm, dst.fWidth, dst.fHeight, 2, &bounds)) {
+		bounds = GRect::MakeLTRB(bounds.left() - stroke.fWidth, bounds.top() - stroke.fWidth,
+				bounds.right() + stroke.fWidth, bounds.bottom() + stroke.fWidth);
+		dashBounds = &bounds;
+	}
 
-		// draw quad polygon
-		GPoint quadPolygonPoints[4];
-		quadPolygonPoints[0] = GPoint::Make(xA - yPrime, yA + xPrime);
-		quadPolygonPoints[1] = GPoint::Make(xA + yPrime, yA - xPrime);
-		quadPolygonPoints[2] = GPoint::Make(xB + yPrime, yB - xPrime);
-		quadPolygonPoints[3] = GPoint::Make(xB - yPrime, yB + xPrime);
-		shadeStrokePolygon(quadPolygonPoints, 4, shader);
-
-		// compute join style
-		float h = abs(prevX) / prevLen + abs(prevY) / prevLen + abs(x) / len + abs(y) / len;
-		int notchPolygonPointCount = h > stroke.fMiterLimit || h == 0 || stroke.fMiterLimit == 3.00 ? 3 : 4;
-
-		// draw notch polygon
-		if (i == 0) {
-			lastBevelPolygonPoint = GPoint::Make(xA + yPrime, yA - xPrime);
-		} else if ((i < loopCount) || (i == loopCount && isClosed)) {
-			notchPolygonPoints[0] = GPoint::Make(xA + yPrime, yA - xPrime);
-			notchPolygonPoints[3] = GPoint::Make(xA + yPrime + prevYPrime, yA - xPrime - prevXPrime);
-			shadeStrokePolygon(notchPolygonPoints, notchPolygonPointCount, shader);
+	if (stroke.fWidth * MyMatrix_MaxScale(ctm) <= 1) {
+		if (dash.isValid()) {
+			HairlineDash hairline = { ctm, stroke.fAddCap, hairlineAntiAlias, &dst, &pipeline, std::vector<GPoint>() };
+			dash.apply(points, pointCount, isClosed, dashBounds, StrokeHairlineDash, &hairline);
+			return;
 		}
 
-		// save info for next loop
-		notchPolygonPoints[1] = GPoint::Make(xB, yB);
-		notchPolygonPoints[2] = GPoint::Make(xB + yPrime, yB - xPrime);
-		prevX = x;
-		prevY = y;
-		prevLen = len;
-		prevXPrime = xPrime;
-		prevYPrime = yPrime;
+		std::vector<GPoint> devicePoints(pointCount);
+		transformPoints(points, devicePoints.data(), pointCount);
+		MyHairline_Stroke(devicePoints.data(), pointCount, isClosed, stroke.fAddCap, hairlineAntiAlias, dst.fWidth,
+				dst.fHeight, pipeline);
+		return;
 	}
+
+	// One outline for the whole polyline (or its dashes), so joins and overlaps are only drawn once
+	MyRasterizer rasterizer(dst.fWidth, dst.fHeight, ctm);
+	MyStroker stroker(stroke, rasterizer, strokeJoin, strokeCap);
+	if (dash.isValid())
+		dash.apply(points, pointCount, isClosed, dashBounds, MyStroker::StrokeDash, &stroker);
+	else
+		stroker.strokePolyline(points, pointCount, isClosed);
+	rasterizer.fill(pipeline);
 }
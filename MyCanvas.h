@@ -8,6 +8,13 @@
 #include "GColor.h"
 #include "GRect.h"
 #include "GShader.h"
+#include "MyColorMatrix.h"
+#include "MyDash.h"
+#include "MyPath.h"
+#include "MyPipeline.h"
+#include "MyShaderCache.h"
+#include "MyShaderFromBitmap.h"
+#include "MyStroker.h"
 
 class Edge {
 public:
@@ -29,6 +36,15 @@ public:
 
 class MyCanvas: public GCanvas {
 public:
+	/**
+	 *  How drawVertices() groups its vertices into triangles.
+	 */
+	enum VertexMode {
+		kTriangles,     // 0 1 2, 3 4 5, ...
+		kTriangleStrip, // 0 1 2, 1 2 3, 2 3 4, ...
+		kTriangleFan    // 0 1 2, 0 2 3, 0 3 4, ...
+	};
+
 	MyCanvas(const GBitmap&);
 
 	/**
@@ -70,6 +86,14 @@ public:
 	 */
 	void fillConvexPolygon(const GPoint[], int count, const GColor&);
 
+	/**
+	 *  Fill polygonCount convex polygons, polygon i with colors[i]: its counts[i] points follow
+	 *  those of the polygons before it in points. Pixels are filled where their centers are
+	 *  inside, and overlapping polygons are drawn in order. The edges of the whole batch are
+	 *  walked in one pass over the rows, so each polygon costs little more than its edges.
+	 */
+	void fillConvexPolygons(const GPoint points[], const int counts[], int polygonCount, const GColor colors[]);
+
 	/**
 	 *  Saves a copy of the CTM, allowing subsequent modifications (by calling concat()) to be
 	 *  undone when restore() is called.
@@ -95,16 +119,60 @@ public:
 
 	/**
 	 *  Fill the specified rect using the shader. The colors returned by the shader are blended
-	 *  into the canvas using SRC_OVER blend mode.
+	 *  into the canvas using the blend mode (SRC_OVER unless changed by setBlendMode()).
 	 */
 	void shadeRect(const GRect& rect, GShader* shader);
 
 	/**
 	 *  Fill the specified polygon using the shader. The colors returned by the shader are blended
-	 *  into the canvas using SRC_OVER blend mode.
+	 *  into the canvas using the blend mode (SRC_OVER unless changed by setBlendMode()).
 	 */
 	void shadeConvexPolygon(const GPoint[], int count, GShader* shader);
 
+	/**
+	 *  Fill the path with the color, or with the shader's colors, following the same
+	 *  "containment" rule as rectangles. Overlapping contours are filled with nonzero winding.
+	 */
+	void fillPath(const MyPath&, const GColor&);
+	void shadePath(const MyPath&, GShader*);
+
+	/**
+	 *  Draw a mesh of triangles made from the count vertices as mode says. Each triangle is
+	 *  colored by interpolating colors[] across it, by the shader mapped so each vertex's
+	 *  texs[] lands on it, or by both multiplied together. Either colors or shader may be
+	 *  NULL, not both; with a shader and no texs, the vertices are its coordinates, as for
+	 *  shadePath(). Pixels are filled where their centers are inside, so triangles sharing an
+	 *  edge don't leave gaps or blend twice along it. The vertices are mapped by the CTM once,
+	 *  and every triangle is drawn through one pipeline.
+	 */
+	void drawVertices(VertexMode, int count, const GPoint vertices[], const GColor colors[],
+			const GPoint texs[], GShader*);
+
+	/**
+	 *  Fill the oval inscribed in the rect with the color, or with the shader's colors,
+	 *  following the same "containment" rule as rectangles. Unless the CTM rotates or skews,
+	 *  each row's span is solved from the ellipse's equation, so an oval costs a square root
+	 *  per row whatever its size.
+	 */
+	void fillOval(const GRect&, const GColor&);
+	void shadeOval(const GRect&, GShader*);
+
+	/**
+	 *  Fill the rect with its corners rounded by radii (top left, top right, bottom right,
+	 *  bottom left), following the same "containment" rule as rectangles. Radii too big for the
+	 *  rect are all scaled down by the same factor until they fit. Unless the CTM rotates or
+	 *  skews, rows between the corners are filled as one rect, and only the corner rows solve
+	 *  for the arcs.
+	 */
+	void fillRRect(const GRect&, const float radii[4], const GColor&);
+
+	/**
+	 *  Stroke the rounded rect: the area between it grown and shrunk by half the stroke's width
+	 *  (with the radii grown and shrunk to match; square corners stay square). Drawn the same
+	 *  way as fillRRect(), with the sides between the corners filled as rects.
+	 */
+	void strokeRRect(const GRect&, const float radii[4], const Stroke&, const GColor&);
+
 	/**
 	 *  Stroke the specified polygon using the Stroke settings. If isClosed is true, then the
 	 *  drawn stroke should connect the first and last points of the polygon, else it should not,
@@ -112,22 +180,118 @@ public:
 	 */
 	void strokePolygon(const GPoint[], int count, bool isClosed, const Stroke&, GShader*);
 
+	/**
+	 *  Stroke the polygon with a solid color. Unlike the GCanvas versions, these don't create a
+	 *  shader for the color on every call. strokeLine writes an aliased, undashed hairline whose
+	 *  color covers what is under it (see MyPipeline::SolidPixel), with no alpha or color
+	 *  matrix, straight into the pixels.
+	 */
+	void strokePolygon(const GPoint[], int count, bool isClosed, const Stroke&, const GColor&);
+	void strokeLine(const GPoint& p0, const GPoint& p1, const Stroke&, const GColor&);
+	void strokeRect(const GRect&, const Stroke&, const GColor&);
+	using GCanvas::strokeLine;
+	using GCanvas::strokeRect;
+
+	/**
+	 *  Set how fillBitmapRect() samples its bitmap. Defaults to kNearest; use kMipmap for
+	 *  bitmaps drawn much smaller than their size.
+	 */
+	void setFilterQuality(MyShaderFromBitmap::FilterQuality);
+
+	/**
+	 *  Set how subsequent fills combine with the pixels already in the canvas. Defaults to
+	 *  kSrcOver. clear() always replaces the pixels.
+	 */
+	void setBlendMode(MyBlendMode);
+
+	/**
+	 *  Set an opacity in [0, 1] that multiplies the colors of every subsequent fill, stroke and
+	 *  shade, on top of their own alpha. Defaults to 1. Changing it doesn't touch any shader, so
+	 *  a fade only needs a new alpha each frame. clear() ignores it.
+	 */
+	void setAlpha(float alpha);
+
+	/**
+	 *  Filter the colors of every subsequent fill, stroke and shade through the color matrix,
+	 *  after the alpha is applied and before they are blended. NULL (the default) turns the
+	 *  filter off. The canvas doesn't own the matrix; it must stay alive while it is set.
+	 */
+	void setColorMatrix(const MyColorMatrix*);
+
+	/**
+	 *  When on, shadeRect(), shadeConvexPolygon() and shadePath() bake the shader's colors over
+	 *  the draw's device bounds into MyShaderCache, and later draws of the same shader under the
+	 *  same CTM copy the baked pixels instead of shading again. Defaults to off. Only MyShaders
+	 *  are baked, and never the canvas's own (such as fillBitmapRect()'s). See MyShaderCache
+	 *  for when a shader must be purged.
+	 */
+	void setShaderCaching(bool);
+
+	/**
+	 *  Set the shape of the outer corners of subsequent strokes, and of their ends when the
+	 *  Stroke's fAddCap asks for caps. Defaults to miter (bevel past the miter limit) joins and
+	 *  square caps. Round ones are drawn with as few chords as look round at the CTM's scale.
+	 */
+	void setStrokeStyle(MyStroker::Join, MyStroker::Cap);
+
+	/**
+	 *  Strokes no wider than a pixel on the device are drawn as hairlines (see MyHairline),
+	 *  aliased by default. When on, hairlines are antialiased instead.
+	 */
+	void setHairlineAntiAlias(bool);
+
+	/**
+	 *  Dash subsequent strokes: intervals alternate between lengths drawn and skipped along the
+	 *  polyline, in local space, starting phase into the pattern (see MyDash). Each dash gets
+	 *  the stroke's caps, and joins where it turns a corner. A pattern that isn't valid,
+	 *  including count == 0, turns dashing off. The intervals are copied.
+	 */
+	void setDash(const float intervals[], int count, float phase);
+
 protected:
 	GBitmap dst;
 	float ctm[6] = { 1, 0, 0, 0, 1, 0 }; // Initialize ctm to identity matrix
 	CTM* ctmStack = NULL; // Initialize ctm stack to be empty
+	MyShaderFromBitmap::FilterQuality filterQuality = MyShaderFromBitmap::kNearest;
+	MyBlendMode blendMode = MyBlendMode::kSrcOver;
+	float alpha = 1;
+	const MyColorMatrix* colorMatrix = NULL;
+	bool shaderCaching = false;
+	MyStroker::Join strokeJoin = MyStroker::kMiterJoin;
+	MyStroker::Cap strokeCap = MyStroker::kSquareCap;
+	bool hairlineAntiAlias = false;
+	MyDash dash;
 
-	void fillPoint(GPoint point, GPixel pixel);
+	// Called once by each draw before it changes dst (however many pipelines it runs)
+	void willDraw();
 
-	void fillLine(float x1, float x2, int y, const GColor& color);
+	// Apply the canvas state (alpha, color matrix) to a new pipeline
+	void setupPipeline(MyPipeline& pipeline);
 
-	void fillLine(float x1, float x2, int y, GShader* shader);
+	// The shader to draw device pixels [left, right) x [top, bottom) with: shader after
+	// setContext(), or its baked copy (kept alive by baked) when caching. NULL to draw nothing.
+	GShader* prepareShader(GShader* shader, int left, int top, int right, int bottom,
+			std::shared_ptr<const MyShaderCache>& baked);
 
-	void fillStroke(float x1, float x2, int y, GShader* shader);
+	void fillLine(float x1, float x2, int y, MyPipeline& pipeline);
+
+	void scanConvexPolygon(const GPoint[], int count, MyPipeline& pipeline);
+
+	void strokePolygon(const GPoint[], int count, bool isClosed, const Stroke&, MyPipeline& pipeline);
+
+	// The device rows [top, bottom) an axis aligned oval covers, and its center and radii in
+	// device space
+	struct DeviceOval {
+		float cx, cy, rx, ry;
+		int top, bottom;
+	};
+
+	// Map the oval to device space (the CTM must be axis aligned); false if it covers nothing
+	bool mapOval(const GRect&, DeviceOval&);
+
+	void scanOval(const DeviceOval&, MyPipeline& pipeline);
 
 	void transformPoints(const GPoint[], GPoint[], int count);
 
 	void transformRect(const GRect& rectUntransformed, GRect& rect);
-
-	void shadeStrokePolygon(const GPoint[], int count, GShader* shader);
 };
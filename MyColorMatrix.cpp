@@ -0,0 +1,124 @@
+/*
+ *  Copyright 2015 Wesley Lo
+ */
+
+#include <algorithm>
+#include "MyColorMatrix.h"
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+static const float kIdentity[20] = {
+	1, 0, 0, 0, 0,
+	0, 1, 0, 0, 0,
+	0, 0, 1, 0, 0,
+	0, 0, 0, 1, 0,
+};
+
+MyColorMatrix::MyColorMatrix(const float matrix[20]) {
+	std::copy(matrix, matrix + 20, this->matrix);
+	alphaScale = (unsigned) (std::max(0.0f, std::min(matrix[18], 1.0f)) * 256 + 0.5f);
+}
+
+bool MyColorMatrix::isIdentity() const {
+	return std::equal(matrix, matrix + 20, kIdentity);
+}
+
+bool MyColorMatrix::isAlphaOnly() const {
+	// Scaling unpremultiplied alpha by s in [0, 1] scales every premultiplied channel by s
+	return std::equal(matrix, matrix + 18, kIdentity) && matrix[18] >= 0 && matrix[18] <= 1 && matrix[19] == 0;
+}
+
+void MyColorMatrix::addStageTo(MyPipeline& pipeline) const {
+	if (isIdentity())
+		return;
+
+	pipeline.addStage(isAlphaOnly() ? ScaleAlpha : Filter, this);
+}
+
+void MyColorMatrix::ScaleAlpha(const void* context, GPixel pixels[], int count) {
+	const uint32_t scale = ((const MyColorMatrix*) context)->alphaScale;
+	const uint32_t mask = 0x00FF00FF;
+	for (int i = 0; i < count; ++i) {
+		uint32_t rb = ((pixels[i] & mask) * scale >> 8) & mask;
+		uint32_t ag = (((pixels[i] >> 8) & mask) * scale) & ~mask;
+		pixels[i] = rb | ag;
+	}
+}
+
+/*
+ *  Both paths work on channels in [0, 255]: unpremultiply by 255 / a, apply the matrix (its
+ *  last column scaled by 255), pin, then premultiply by A' / 255 and round. They do the same
+ *  float operations in the same order, so their output is identical.
+ */
+void MyColorMatrix::Filter(const void* context, GPixel pixels[], int count) {
+	const float* m = ((const MyColorMatrix*) context)->matrix;
+	int i = 0;
+
+#ifdef __AVX2__
+	__m256 vm[20];
+	for (int k = 0; k < 20; ++k) {
+		vm[k] = _mm256_set1_ps(k % 5 == 4 ? m[k] * 255 : m[k]);
+	}
+	const __m256i mask = _mm256_set1_epi32(0xFF);
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 max = _mm256_set1_ps(255);
+	const __m256 inv255 = _mm256_set1_ps(1 / 255.0f);
+	const __m256 half = _mm256_set1_ps(0.5f);
+
+	for (; i + 8 <= count; i += 8) {
+		__m256i p = _mm256_loadu_si256((const __m256i*) &pixels[i]);
+		__m256 a = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(p, GPIXEL_SHIFT_A), mask));
+		__m256 r = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(p, GPIXEL_SHIFT_R), mask));
+		__m256 g = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(p, GPIXEL_SHIFT_G), mask));
+		__m256 b = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(p, GPIXEL_SHIFT_B), mask));
+
+		// Transparent pixels unpremultiply to transparent black
+		__m256 scale = _mm256_and_ps(_mm256_div_ps(max, a), _mm256_cmp_ps(a, zero, _CMP_GT_OQ));
+		r = _mm256_mul_ps(r, scale);
+		g = _mm256_mul_ps(g, scale);
+		b = _mm256_mul_ps(b, scale);
+
+		__m256 out[4];
+		for (int row = 0; row < 4; ++row) {
+			const __m256* mr = &vm[row * 5];
+			__m256 v = _mm256_add_ps(_mm256_mul_ps(mr[0], r), _mm256_mul_ps(mr[1], g));
+			v = _mm256_add_ps(v, _mm256_mul_ps(mr[2], b));
+			v = _mm256_add_ps(v, _mm256_mul_ps(mr[3], a));
+			v = _mm256_add_ps(v, mr[4]);
+			out[row] = _mm256_min_ps(_mm256_max_ps(v, zero), max);
+		}
+
+		__m256 premul = _mm256_mul_ps(out[3], inv255);
+		__m256i result = _mm256_slli_epi32(_mm256_cvttps_epi32(_mm256_add_ps(out[3], half)), GPIXEL_SHIFT_A);
+		for (int c = 0; c < 3; ++c) {
+			static const int shifts[3] = { GPIXEL_SHIFT_R, GPIXEL_SHIFT_G, GPIXEL_SHIFT_B };
+			__m256i channel = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(out[c], premul), half));
+			result = _mm256_or_si256(result, _mm256_sllv_epi32(channel, _mm256_set1_epi32(shifts[c])));
+		}
+		_mm256_storeu_si256((__m256i*) &pixels[i], result);
+	}
+#endif
+
+	for (; i < count; ++i) {
+		float a = GPixel_GetA(pixels[i]);
+		float scale = a > 0 ? 255 / a : 0;
+		float in[4] = { GPixel_GetR(pixels[i]) * scale, GPixel_GetG(pixels[i]) * scale,
+				GPixel_GetB(pixels[i]) * scale, a };
+
+		float out[4];
+		for (int row = 0; row < 4; ++row) {
+			const float* mr = &m[row * 5];
+			float v = mr[0] * in[0] + mr[1] * in[1];
+			v = v + mr[2] * in[2];
+			v = v + mr[3] * in[3];
+			v = v + mr[4] * 255;
+			out[row] = std::min(std::max(v, 0.0f), 255.0f);
+		}
+
+		float premul = out[3] * (1 / 255.0f);
+		pixels[i] = GPixel_PackARGB((int) (out[3] + 0.5f), (int) (out[0] * premul + 0.5f),
+				(int) (out[1] * premul + 0.5f), (int) (out[2] * premul + 0.5f));
+	}
+}
@@ -0,0 +1,46 @@
+/*
+ *  Copyright 2015 Wesley Lo
+ */
+
+#ifndef MyColorMatrix_DEFINED
+#define MyColorMatrix_DEFINED
+
+#include "MyPipeline.h"
+
+/**
+ *  A 4x5 color matrix filter, run as a pipeline stage on shaded (or solid) colors before they
+ *  are blended. Each unpremultiplied color [R G B A] in [0, 1] becomes
+ *
+ *  [ R' ]   [ m0  m1  m2  m3  m4  ]   [ R ]
+ *  [ G' ] = [ m5  m6  m7  m8  m9  ] * [ G ]
+ *  [ B' ]   [ m10 m11 m12 m13 m14 ]   [ B ]
+ *  [ A' ]   [ m15 m16 m17 m18 m19 ]   [ A ]
+ *                                     [ 1 ]
+ *
+ *  pinned to [0, 1] and premultiplied again.
+ */
+class MyColorMatrix {
+public:
+	MyColorMatrix(const float matrix[20]);
+
+	/**
+	 *  Add the filter to the pipeline. An identity matrix adds nothing, and a matrix that only
+	 *  scales alpha (by at most 1) adds a scale of the premultiplied color instead of the full
+	 *  matrix. The matrix must outlive the pipeline.
+	 */
+	void addStageTo(MyPipeline&) const;
+
+	bool isIdentity() const;
+
+	bool isAlphaOnly() const;
+
+protected:
+	float matrix[20];
+	unsigned alphaScale; // m18 in [0, 256], for alpha only matrices
+
+	// The stages; context points at the MyColorMatrix
+	static void Filter(const void* context, GPixel pixels[], int count);
+	static void ScaleAlpha(const void* context, GPixel pixels[], int count);
+};
+
+#endif
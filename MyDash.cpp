@@ -0,0 +1,151 @@
+/*
+ *  Copyright 2015 Wesley Lo
+ */
+
+#include <algorithm>
+#include <cmath>
+#include "MyDash.h"
+
+enum {
+	// The most interval ends walked along one segment; the rest of it is skipped over. Only
+	// patterns far finer than a pixel come near this.
+	kMaxBoundaries = 1 << 20
+};
+
+// The point t along the segment from a, in the unit direction
+static inline GPoint PointAt(const GPoint& a, const GPoint& direction, double t) {
+	return GPoint::Make(a.fX + direction.fX * t, a.fY + direction.fY * t);
+}
+
+// Find the part [t0, t1] of the segment from a, in the unit direction for length, that is
+// inside bounds. Returns false if none of it is.
+static bool ClipToBounds(const GPoint& a, const GPoint& direction, double length, const GRect& bounds, double* t0,
+		double* t1) {
+	const double origin[2] = { a.fX, a.fY };
+	const double step[2] = { direction.fX, direction.fY };
+	const double lo[2] = { bounds.left(), bounds.top() };
+	const double hi[2] = { bounds.right(), bounds.bottom() };
+	*t0 = 0;
+	*t1 = length;
+	for (int axis = 0; axis < 2; ++axis) {
+		if (step[axis] == 0) {
+			if (origin[axis] < lo[axis] || origin[axis] > hi[axis])
+				return false;
+			continue;
+		}
+		double enter = (lo[axis] - origin[axis]) / step[axis];
+		double exit = (hi[axis] - origin[axis]) / step[axis];
+		if (enter > exit)
+			std::swap(enter, exit);
+		*t0 = std::max(*t0, enter);
+		*t1 = std::min(*t1, exit);
+	}
+	return *t0 <= *t1;
+}
+
+MyDash::MyDash() {
+}
+
+MyDash::MyDash(const float intervals[], int count, float phase) {
+	if (count <= 0 || count % 2 != 0)
+		return;
+
+	float length = 0;
+	for (int i = 0; i < count; ++i) {
+		if (!(intervals[i] >= 0))
+			return;
+		length += intervals[i];
+	}
+	if (!(length > 0) || !std::isfinite(length) || !std::isfinite(phase))
+		return;
+
+	this->intervals.assign(intervals, intervals + count);
+	this->length = length;
+	this->phase = fmodf(phase, length);
+	if (this->phase < 0)
+		this->phase += length;
+}
+
+bool MyDash::isValid() const {
+	return !intervals.empty();
+}
+
+void MyDash::apply(const GPoint pts[], int count, bool isClosed, const GRect* bounds, DashProc proc, void* context) {
+	if (!isValid() || count < 2)
+		return;
+
+	// Find where the phase falls in the pattern. An interval ending right at the phase is done
+	// with, unless it is empty (a zero length dash right at the phase still gets drawn).
+	const int intervalCount = intervals.size();
+	int index = 0;
+	float remaining = intervals[0] - phase;
+	while (index < intervalCount - 1 && (remaining < 0 || (remaining == 0 && intervals[index] > 0))) {
+		remaining += intervals[++index];
+	}
+	bool on = index % 2 == 0;
+
+	dash.clear();
+	if (on)
+		dash.push_back(pts[0]);
+
+	GPoint direction = GPoint::Make(1, 0);
+	const int segments = isClosed ? count : count - 1;
+	for (int i = 0; i < segments; ++i) {
+		const GPoint& a = pts[i];
+		const GPoint& b = pts[(i + 1) % count];
+		float dx = b.fX - a.fX;
+		float dy = b.fY - a.fY;
+		float segmentLength = sqrtf(dx * dx + dy * dy);
+		if (segmentLength == 0)
+			continue;
+		direction = GPoint::Make(dx / segmentLength, dy / segmentLength);
+
+		// Only [t0, t1] of the segment can be seen; a segment out of bounds is all skipped
+		double t0 = 0, t1 = segmentLength;
+		if (bounds && !ClipToBounds(a, direction, segmentLength, *bounds, &t0, &t1))
+			t0 = t1 = segmentLength;
+
+		// Every interval that ends along this segment starts the next one there. Where they end
+		// is measured from a, rather than stepped to, so each is found exactly on long segments.
+		double end = remaining;
+		int boundaries = 0;
+		while (end <= segmentLength) {
+			GPoint p = PointAt(a, direction, end);
+			if (on) {
+				dash.push_back(p);
+				proc(context, dash.data(), dash.size(), direction);
+			}
+			dash.clear();
+			index = (index + 1) % intervalCount;
+			on = index % 2 == 0;
+			if (on)
+				dash.push_back(p);
+			end += intervals[index];
+
+			// Skip the intervals that end before [t0, t1], or start after it, to the one that
+			// reaches into it (or to the end of the segment)
+			double target;
+			if (end < t0)
+				target = t0;
+			else if (end < segmentLength && (end - intervals[index] > t1 || ++boundaries >= kMaxBoundaries))
+				target = segmentLength;
+			else
+				continue;
+			end += floor((target - end) / length) * length;
+			for (int step = 0; step < intervalCount && end < target; ++step) {
+				index = (index + 1) % intervalCount;
+				end += intervals[index];
+			}
+			on = index % 2 == 0;
+			dash.clear();
+			if (on)
+				dash.push_back(PointAt(a, direction, end - intervals[index]));
+		}
+		remaining = end - segmentLength;
+		if (on)
+			dash.push_back(b);
+	}
+
+	if (on && !dash.empty())
+		proc(context, dash.data(), dash.size(), direction);
+}
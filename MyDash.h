@@ -0,0 +1,53 @@
+/*
+ *  Copyright 2015 Wesley Lo
+ */
+
+#ifndef MyDash_DEFINED
+#define MyDash_DEFINED
+
+#include <vector>
+#include "GPoint.h"
+#include "GRect.h"
+
+/**
+ *  A dash pattern: alternating lengths that are on and off along a polyline, starting phase
+ *  into the pattern. The pattern repeats for as long as the polyline goes, continuing around
+ *  the corners and, for closed polylines, the closing segment.
+ *
+ *  A pattern needs an even number of intervals, none negative, adding up to more than 0.
+ *  Anything else (including no intervals) is not valid, and dashes nothing.
+ */
+class MyDash {
+public:
+	/**
+	 *  Called with each dash as it is found: the points of a piece of the polyline, in order.
+	 *  direction is the unit direction of the polyline where the dash ends, for dashes of zero
+	 *  length (all of their points the same) that only draw their caps.
+	 */
+	typedef void (*DashProc)(void* context, const GPoint pts[], int count, const GPoint& direction);
+
+	MyDash();
+	MyDash(const float intervals[], int count, float phase);
+
+	bool isValid() const;
+
+	/**
+	 *  Walk the polyline, calling proc with each dash. The dash's points are only valid during
+	 *  the call; the buffer holding them is reused for the next.
+	 *
+	 *  If bounds is not NULL, dashes that lie within a segment and entirely outside of bounds are
+	 *  skipped over without being walked, so a long segment only costs the dashes near bounds.
+	 *  Dashes reaching a corner or an end of the polyline are always drawn.
+	 */
+	void apply(const GPoint pts[], int count, bool isClosed, const GRect* bounds, DashProc proc, void* context);
+
+private:
+	std::vector<float> intervals;
+	float phase = 0;
+	float length = 0;
+
+	// The dash being walked
+	std::vector<GPoint> dash;
+};
+
+#endif
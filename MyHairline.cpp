@@ -0,0 +1,224 @@
+/*
+ *  Copyright 2015 Wesley Lo
+ */
+
+#include <algorithm>
+#include <cmath>
+#include "MyHairline.h"
+
+// 16.16 fixed point
+static const int kFixedShift = 16;
+static const float kFixedOne = 1 << kFixedShift;
+
+// Segments are clipped to the device outset by this many pixels before they are stepped, so the
+// pixels they light are the same and the fixed point stays small
+static const float kClipPad = 2;
+
+// floorf and friends are library calls without SSE4.1, and cost more than the rest of a short line
+static inline int floorToInt(float x) {
+	int i = (int) x;
+	return i > x ? i - 1 : i;
+}
+
+static inline int ceilToInt(float x) {
+	return -floorToInt(-x);
+}
+
+// Where the pixels of a walk go: through the draw's pipeline or, if it is NULL, straight into dst
+// as the one pixel they all become (aliased walks only)
+struct Blitter {
+	MyPipeline* pipeline;
+	const GBitmap* dst;
+	GPixel pixel;
+
+	void blitSpan(int x, int y, int count) {
+		if (pipeline)
+			pipeline->run(x, y, count);
+		else
+			std::fill_n(dst->getAddr(x, y), count, pixel);
+	}
+};
+
+/**
+ *  Step along u over pixels [u, uEnd), lighting at each the pixel the line through (u0, v0)
+ *  with the given slope passes through in v. swapped says u is y (and v is x) on the device.
+ */
+static void walk(int u, int uEnd, float u0, float v0, float slope, bool swapped, bool antiAlias,
+		int width, int height, Blitter& blitter) {
+	const int uLimit = swapped ? height : width;
+	const int vLimit = swapped ? width : height;
+	u = std::max(u, 0);
+	uEnd = std::min(uEnd, uLimit);
+	if (u >= uEnd)
+		return;
+
+	// v at the center of the first step, and per step, in fixed point
+	int fv = floorToInt((v0 + (u + 0.5f - u0) * slope) * kFixedOne + 0.5f);
+	int dfv = floorToInt(slope * kFixedOne + 0.5f);
+
+	if (antiAlias) {
+		// Split each step between the pixels whose centers are on either side of the line
+		for (; u < uEnd; ++u, fv += dfv) {
+			int below = fv - (1 << (kFixedShift - 1));
+			int v = below >> kFixedShift;
+			uint8_t coverage[2];
+			coverage[1] = (below & (int) (kFixedOne - 1)) >> (kFixedShift - 8);
+			coverage[0] = 255 - coverage[1];
+			for (int i = 0; i < 2; ++i) {
+				if (v + i < 0 || v + i >= vLimit || coverage[i] == 0)
+					continue;
+				if (swapped)
+					blitter.pipeline->run(v + i, u, 1, &coverage[i]);
+				else
+					blitter.pipeline->run(u, v + i, 1, &coverage[i]);
+			}
+		}
+		return;
+	}
+
+	if (!blitter.pipeline) {
+		// Solid: store each step's pixel, stepping along u and v by their strides in dst
+		char* const pixels = (char*) blitter.dst->fPixels;
+		const size_t pixelBytes = sizeof(GPixel);
+		const size_t uStride = swapped ? blitter.dst->fRowBytes : pixelBytes;
+		const size_t vStride = swapped ? pixelBytes : blitter.dst->fRowBytes;
+		for (; u < uEnd; ++u, fv += dfv) {
+			int v = fv >> kFixedShift;
+			if (v >= 0 && v < vLimit)
+				*(GPixel*) (pixels + u * uStride + v * vStride) = blitter.pixel;
+		}
+		return;
+	}
+
+	if (swapped) {
+		// Steep: every step is its own row
+		for (; u < uEnd; ++u, fv += dfv) {
+			int v = fv >> kFixedShift;
+			if (v >= 0 && v < vLimit)
+				blitter.blitSpan(v, u, 1);
+		}
+		return;
+	}
+
+	// Shallow: consecutive steps on the same row make one span
+	int spanStart = u;
+	int row = fv >> kFixedShift;
+	for (; u < uEnd; ++u, fv += dfv) {
+		int v = fv >> kFixedShift;
+		if (v != row) {
+			if (row >= 0 && row < vLimit)
+				blitter.blitSpan(spanStart, row, u - spanStart);
+			spanStart = u;
+			row = v;
+		}
+	}
+	if (row >= 0 && row < vLimit)
+		blitter.blitSpan(spanStart, row, uEnd - spanStart);
+}
+
+/**
+ *  Clip the segment to the width x height device, outset by kClipPad. Ends already inside are
+ *  left as they are. Returns false if none of the segment (or a coordinate that isn't finite)
+ *  is inside.
+ */
+static bool clip(GPoint& p0, GPoint& p1, int width, int height) {
+	const float right = width + kClipPad;
+	const float bottom = height + kClipPad;
+	if (!std::isfinite(p0.fX) || !std::isfinite(p0.fY) || !std::isfinite(p1.fX) || !std::isfinite(p1.fY))
+		return false;
+	if (std::min(std::min(p0.fX, p1.fX), std::min(p0.fY, p1.fY)) >= -kClipPad && std::max(p0.fX, p1.fX) <= right
+			&& std::max(p0.fY, p1.fY) <= bottom)
+		return true;
+
+	// Parametric: p0 + t * (p1 - p0) for t in [t0, t1]
+	const double start[2] = { p0.fX, p0.fY };
+	const double delta[2] = { (double) p1.fX - p0.fX, (double) p1.fY - p0.fY };
+	const double lo = -kClipPad;
+	const double hi[2] = { right, bottom };
+	double t0 = 0, t1 = 1;
+	for (int axis = 0; axis < 2; ++axis) {
+		if (delta[axis] == 0) {
+			if (start[axis] < lo || start[axis] > hi[axis])
+				return false;
+			continue;
+		}
+		double enter = (lo - start[axis]) / delta[axis];
+		double exit = (hi[axis] - start[axis]) / delta[axis];
+		if (enter > exit)
+			std::swap(enter, exit);
+		t0 = std::max(t0, enter);
+		t1 = std::min(t1, exit);
+	}
+	if (t0 > t1)
+		return false;
+
+	if (t1 < 1)
+		p1 = GPoint::Make(start[0] + delta[0] * t1, start[1] + delta[1] * t1);
+	if (t0 > 0)
+		p0 = GPoint::Make(start[0] + delta[0] * t0, start[1] + delta[1] * t0);
+	return true;
+}
+
+static void segment(GPoint p0, GPoint p1, bool antiAlias, int width, int height, Blitter& blitter) {
+	if (!clip(p0, p1, width, height))
+		return;
+
+	bool swapped = fabsf(p1.fY - p0.fY) > fabsf(p1.fX - p0.fX);
+	if (swapped) {
+		std::swap(p0.fX, p0.fY);
+		std::swap(p1.fX, p1.fY);
+	}
+	if (p0.fX == p1.fX)
+		return;
+
+	// The steps whose centers c + 0.5 are in [start, end) going one way, (end, start] the other
+	int u, uEnd;
+	if (p0.fX < p1.fX) {
+		u = ceilToInt(p0.fX - 0.5f);
+		uEnd = ceilToInt(p1.fX - 0.5f);
+	} else {
+		u = floorToInt(p1.fX - 0.5f) + 1;
+		uEnd = floorToInt(p0.fX - 0.5f) + 1;
+	}
+	float slope = (p1.fY - p0.fY) / (p1.fX - p0.fX);
+	walk(u, uEnd, p0.fX, p0.fY, slope, swapped, antiAlias, width, height, blitter);
+}
+
+static void strokePolyline(const GPoint pts[], int count, bool isClosed, bool addCap, bool antiAlias,
+		int width, int height, Blitter& blitter) {
+	if (count < 2)
+		return;
+
+	const int segments = isClosed ? count : count - 1;
+	for (int i = 0; i < segments; ++i) {
+		GPoint p0 = pts[i];
+		GPoint p1 = pts[(i + 1) % count];
+		if (addCap && !isClosed) {
+			// Half a pixel further out at the ends of the polyline
+			float dx = p1.fX - p0.fX;
+			float dy = p1.fY - p0.fY;
+			float length = sqrtf(dx * dx + dy * dy);
+			if (length > 0) {
+				dx *= 0.5f / length;
+				dy *= 0.5f / length;
+				if (i == 0)
+					p0 = GPoint::Make(p0.fX - dx, p0.fY - dy);
+				if (i == segments - 1)
+					p1 = GPoint::Make(p1.fX + dx, p1.fY + dy);
+			}
+		}
+		segment(p0, p1, antiAlias, width, height, blitter);
+	}
+}
+
+void MyHairline_Stroke(const GPoint pts[], int count, bool isClosed, bool addCap, bool antiAlias,
+		int width, int height, MyPipeline& pipeline) {
+	Blitter blitter = { &pipeline, NULL, 0 };
+	strokePolyline(pts, count, isClosed, addCap, antiAlias, width, height, blitter);
+}
+
+void MyHairline_StrokeSolid(const GPoint pts[], int count, bool isClosed, bool addCap, const GBitmap& dst,
+		GPixel pixel) {
+	Blitter blitter = { NULL, &dst, pixel };
+	strokePolyline(pts, count, isClosed, addCap, false, dst.fWidth, dst.fHeight, blitter);
+}
@@ -0,0 +1,36 @@
+/*
+ *  Copyright 2015 Wesley Lo
+ */
+
+#ifndef MyHairline_DEFINED
+#define MyHairline_DEFINED
+
+#include "GPoint.h"
+#include "MyPipeline.h"
+
+/**
+ *  Draw the polyline pts[0] ... pts[count - 1] (back to pts[0] if isClosed), already in device
+ *  space, as hairlines: one pixel thick whatever the stroke's width, for strokes no wider than
+ *  a pixel on the device. Pixels are clipped to width x height.
+ *
+ *  Each segment steps along its longer axis one pixel at a time in 16.16 fixed point, lighting
+ *  the pixel its center line passes through. A segment covers the pixels from its start up to,
+ *  but not including, its end, so a polyline doesn't draw the pixels it turns on twice. With
+ *  addCap, open polylines reach half a pixel further at both ends.
+ *
+ *  With antiAlias, each step instead splits its pixel between the two pixels the center line
+ *  passes between, by how close it is to each (Wu's algorithm).
+ */
+void MyHairline_Stroke(const GPoint pts[], int count, bool isClosed, bool addCap, bool antiAlias,
+		int width, int height, MyPipeline&);
+
+/**
+ *  Draw the polyline as aliased hairlines by writing pixel into each pixel they light in dst,
+ *  for draws that set every covered pixel to the same value whatever was there (see
+ *  MyPipeline::SolidPixel). This skips building and running a pipeline, which costs more than
+ *  walking the short lines of a plot or wireframe.
+ */
+void MyHairline_StrokeSolid(const GPoint pts[], int count, bool isClosed, bool addCap, const GBitmap& dst,
+		GPixel pixel);
+
+#endif
@@ -0,0 +1,72 @@
+/*
+ *  Copyright 2015 Wesley Lo
+ */
+
+#ifndef MyLowp_DEFINED
+#define MyLowp_DEFINED
+
+#include "GPixel.h"
+
+/**
+ *  Low precision (lowp) helpers: premultiplied channels as 16 bit integers, one channel of 16
+ *  pixels per AVX2 register. 8 bit output only needs about 9 bits of intermediate precision,
+ *  so the blend and two stop gradient math fits in 16 bit lanes, twice as many as 32 bit float.
+ *
+ *  The scalar code next to each use computes the same values, so output doesn't depend on
+ *  whether AVX2 is available.
+ */
+
+#ifdef __AVX2__
+#include <immintrin.h>
+
+struct MyLowp16 {
+	__m256i a, r, g, b;
+};
+
+// Lanes come out of packus_epi32 interleaved per 128 bit half; MyLowp_Store16 undoes it
+static inline __m256i MyLowp_Channel(__m256i lo, __m256i hi, int shift) {
+	const __m256i mask = _mm256_set1_epi32(0xFF);
+	return _mm256_packus_epi32(_mm256_and_si256(_mm256_srli_epi32(lo, shift), mask),
+			_mm256_and_si256(_mm256_srli_epi32(hi, shift), mask));
+}
+
+static inline MyLowp16 MyLowp_Load16(const GPixel src[16]) {
+	__m256i lo = _mm256_loadu_si256((const __m256i*) &src[0]);
+	__m256i hi = _mm256_loadu_si256((const __m256i*) &src[8]);
+	MyLowp16 p;
+	p.a = MyLowp_Channel(lo, hi, GPIXEL_SHIFT_A);
+	p.r = MyLowp_Channel(lo, hi, GPIXEL_SHIFT_R);
+	p.g = MyLowp_Channel(lo, hi, GPIXEL_SHIFT_G);
+	p.b = MyLowp_Channel(lo, hi, GPIXEL_SHIFT_B);
+	return p;
+}
+
+static inline void MyLowp_Store16(GPixel dst[16], const MyLowp16& p) {
+	const __m256i zero = _mm256_setzero_si256();
+	__m256i lo = _mm256_or_si256(
+			_mm256_or_si256(_mm256_slli_epi32(_mm256_unpacklo_epi16(p.a, zero), GPIXEL_SHIFT_A),
+					_mm256_slli_epi32(_mm256_unpacklo_epi16(p.r, zero), GPIXEL_SHIFT_R)),
+			_mm256_or_si256(_mm256_slli_epi32(_mm256_unpacklo_epi16(p.g, zero), GPIXEL_SHIFT_G),
+					_mm256_slli_epi32(_mm256_unpacklo_epi16(p.b, zero), GPIXEL_SHIFT_B)));
+	__m256i hi = _mm256_or_si256(
+			_mm256_or_si256(_mm256_slli_epi32(_mm256_unpackhi_epi16(p.a, zero), GPIXEL_SHIFT_A),
+					_mm256_slli_epi32(_mm256_unpackhi_epi16(p.r, zero), GPIXEL_SHIFT_R)),
+			_mm256_or_si256(_mm256_slli_epi32(_mm256_unpackhi_epi16(p.g, zero), GPIXEL_SHIFT_G),
+					_mm256_slli_epi32(_mm256_unpackhi_epi16(p.b, zero), GPIXEL_SHIFT_B)));
+	_mm256_storeu_si256((__m256i*) &dst[0], lo);
+	_mm256_storeu_si256((__m256i*) &dst[8], hi);
+}
+
+// x / 255 rounded, for x in [0, 255 * 255]: ((x + 128) * 257) >> 16, as in the scalar div255
+static inline __m256i MyLowp_Div255(__m256i x) {
+	return _mm256_mulhi_epu16(_mm256_add_epi16(x, _mm256_set1_epi16(128)), _mm256_set1_epi16(257));
+}
+
+// (a * (256 - w) + b * w) >> 8 per lane, for channels a, b in [0, 255] and w in [0, 256]
+static inline __m256i MyLowp_Lerp(__m256i a, __m256i b, __m256i w) {
+	__m256i invW = _mm256_sub_epi16(_mm256_set1_epi16(256), w);
+	return _mm256_srli_epi16(_mm256_add_epi16(_mm256_mullo_epi16(a, invW), _mm256_mullo_epi16(b, w)), 8);
+}
+#endif
+
+#endif
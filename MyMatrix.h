@@ -0,0 +1,84 @@
+/*
+ *  Copyright 2015 Wesley Lo
+ */
+
+#ifndef MyMatrix_DEFINED
+#define MyMatrix_DEFINED
+
+#include <algorithm>
+#include <cmath>
+#include "GPoint.h"
+
+/**
+ *  Helpers for the 2x3 affine matrices used by the canvas and the shaders.
+ *
+ *  [ A B C ]
+ *  [ D E F ]   stored as { A, B, C, D, E, F }
+ *  [ 0 0 1 ]
+ */
+
+/**
+ *  result = a * b, so that mapping by result is the same as mapping by b and then by a.
+ *  result may alias a or b.
+ */
+static inline void MyMatrix_Concat(const float a[6], const float b[6], float result[6]) {
+	float concatMatrix[6];
+
+	concatMatrix[0] = a[0] * b[0] + a[1] * b[3];
+	concatMatrix[1] = a[0] * b[1] + a[1] * b[4];
+	concatMatrix[2] = a[0] * b[2] + a[1] * b[5] + a[2];
+	concatMatrix[3] = a[3] * b[0] + a[4] * b[3];
+	concatMatrix[4] = a[3] * b[1] + a[4] * b[4];
+	concatMatrix[5] = a[3] * b[2] + a[4] * b[5] + a[5];
+
+	for (int i = 0; i < 6; ++i) {
+		result[i] = concatMatrix[i];
+	}
+}
+
+/**
+ *  Compute the inverse of matrix. Returns false (and leaves inverse untouched) if the matrix
+ *  is singular. inverse may alias matrix.
+ */
+static inline bool MyMatrix_Invert(const float matrix[6], float inverse[6]) {
+	double det = (double) matrix[0] * matrix[4] - (double) matrix[1] * matrix[3];
+	if (det == 0 || !std::isfinite(det))
+		return false;
+
+	double invDet = 1 / det;
+	float a = matrix[4] * invDet;
+	float b = -matrix[1] * invDet;
+	float d = -matrix[3] * invDet;
+	float e = matrix[0] * invDet;
+	float c = -(a * matrix[2] + b * matrix[5]);
+	float f = -(d * matrix[2] + e * matrix[5]);
+
+	inverse[0] = a;
+	inverse[1] = b;
+	inverse[2] = c;
+	inverse[3] = d;
+	inverse[4] = e;
+	inverse[5] = f;
+	return true;
+}
+
+static inline GPoint MyMatrix_MapPoint(const float matrix[6], float x, float y) {
+	return GPoint::Make(matrix[0] * x + matrix[1] * y + matrix[2], matrix[3] * x + matrix[4] * y + matrix[5]);
+}
+
+/**
+ *  How much the matrix stretches lengths along its longer axis.
+ */
+static inline float MyMatrix_MaxScale(const float matrix[6]) {
+	return std::max(sqrtf(matrix[0] * matrix[0] + matrix[3] * matrix[3]),
+			sqrtf(matrix[1] * matrix[1] + matrix[4] * matrix[4]));
+}
+
+/**
+ *  True if the matrix only scales and translates (no rotation or skew).
+ */
+static inline bool MyMatrix_IsAxisAligned(const float matrix[6]) {
+	return matrix[1] == 0 && matrix[3] == 0;
+}
+
+#endif
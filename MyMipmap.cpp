@@ -0,0 +1,171 @@
+/*
+ *  Copyright 2015 Wesley Lo
+ */
+
+#include <cmath>
+#include <list>
+#include "MyMipmap.h"
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+// Most recently used chains first
+static std::list<std::shared_ptr<const MyMipmap> > gMipmapCache;
+static size_t gMipmapCacheBytes = 0;
+static size_t gMipmapCacheBudget = 32 * 1024 * 1024;
+
+// Average four premultiplied pixels, two channels at a time
+static inline GPixel average4(GPixel a, GPixel b, GPixel c, GPixel d) {
+	const uint32_t mask = 0x00FF00FF;
+	const uint32_t round = 0x00020002;
+	uint32_t rb = (((a & mask) + (b & mask) + (c & mask) + (d & mask) + round) >> 2) & mask;
+	uint32_t ag = ((((a >> 8) & mask) + ((b >> 8) & mask) + ((c >> 8) & mask) + ((d >> 8) & mask) + round) << 6) & ~mask;
+	return rb | ag;
+}
+
+// Make each pixel of dst the average of the 2x2 block of src pixels under it
+static void downsample(const GBitmap& src, const GBitmap& dst) {
+	for (int y = 0; y < dst.fHeight; ++y) {
+		const GPixel* row0 = src.getAddr(0, 2 * y);
+		const GPixel* row1 = src.getAddr(0, 2 * y + 1);
+		GPixel* dst_row = dst.getAddr(0, y);
+		int x = 0;
+
+#ifdef __AVX2__
+		// Eight source pixels from each row make four destination pixels
+		const __m256i zero = _mm256_setzero_si256();
+		const __m256i round = _mm256_set1_epi16(2);
+		for (; x + 4 <= dst.fWidth; x += 4) {
+			__m256i top = _mm256_loadu_si256((const __m256i*) &row0[2 * x]);
+			__m256i bottom = _mm256_loadu_si256((const __m256i*) &row1[2 * x]);
+
+			// Sum vertically in 16 bits per channel, then add neighbouring pixels together
+			__m256i lo = _mm256_add_epi16(_mm256_unpacklo_epi8(top, zero), _mm256_unpacklo_epi8(bottom, zero));
+			__m256i hi = _mm256_add_epi16(_mm256_unpackhi_epi8(top, zero), _mm256_unpackhi_epi8(bottom, zero));
+			lo = _mm256_add_epi16(lo, _mm256_srli_si256(lo, 8));
+			hi = _mm256_add_epi16(hi, _mm256_srli_si256(hi, 8));
+
+			__m256i sum = _mm256_srli_epi16(_mm256_add_epi16(_mm256_unpacklo_epi64(lo, hi), round), 2);
+			__m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(sum, sum), 0x08);
+			_mm_storeu_si128((__m128i*) &dst_row[x], _mm256_castsi256_si128(packed));
+		}
+#endif
+
+		for (; x < dst.fWidth; ++x) {
+			dst_row[x] = average4(row0[2 * x], row0[2 * x + 1], row1[2 * x], row1[2 * x + 1]);
+		}
+	}
+}
+
+MyMipmap::MyMipmap(uint32_t ownerID, const GBitmap& bitmap) {
+	this->ownerID = ownerID;
+	pixels = bitmap.fPixels;
+	width = bitmap.fWidth;
+	height = bitmap.fHeight;
+	rowBytes = bitmap.fRowBytes;
+
+	// Level 0 is the caller's bitmap; only the smaller levels are owned by the chain
+	levels.push_back(bitmap);
+	while (levels.back().fWidth > 1 || levels.back().fHeight > 1) {
+		const GBitmap& prev = levels.back();
+		GBitmap next;
+		next.fWidth = std::max(prev.fWidth >> 1, 1);
+		next.fHeight = std::max(prev.fHeight >> 1, 1);
+		next.fRowBytes = next.fWidth * sizeof(GPixel);
+		next.fPixels = (GPixel*) malloc(next.fRowBytes * next.fHeight);
+
+		if (prev.fWidth == 1 || prev.fHeight == 1) {
+			// Only one dimension left to halve; average pairs instead of 2x2 blocks
+			for (int y = 0; y < next.fHeight; ++y) {
+				for (int x = 0; x < next.fWidth; ++x) {
+					int x0 = std::min(2 * x, prev.fWidth - 1), x1 = std::min(2 * x + 1, prev.fWidth - 1);
+					int y0 = std::min(2 * y, prev.fHeight - 1), y1 = std::min(2 * y + 1, prev.fHeight - 1);
+					next.getAddr(x, y)[0] = average4(prev.getAddr(x0, y0)[0], prev.getAddr(x1, y0)[0],
+							prev.getAddr(x0, y1)[0], prev.getAddr(x1, y1)[0]);
+				}
+			}
+		} else {
+			downsample(prev, next);
+		}
+
+		byteCount += next.fRowBytes * next.fHeight;
+		levels.push_back(next);
+	}
+}
+
+MyMipmap::~MyMipmap() {
+	for (size_t i = 1; i < levels.size(); ++i) {
+		free(levels[i].fPixels);
+	}
+}
+
+int MyMipmap::chooseLevel(float scale) const {
+	if (!(scale > 1))
+		return 0;
+
+	// Each level halves the size, so log2 of the scale keeps the step per device pixel in [1, 2)
+	int level = (int) floorf(log2f(scale));
+	return std::max(0, std::min(level, levelCount() - 1));
+}
+
+bool MyMipmap::matches(uint32_t ownerID, const GBitmap& bitmap) const {
+	return this->ownerID == ownerID && pixels == bitmap.fPixels && width == bitmap.fWidth && height == bitmap.fHeight
+			&& rowBytes == bitmap.fRowBytes;
+}
+
+std::shared_ptr<const MyMipmap> MyMipmap::Find(uint32_t ownerID, const GBitmap& bitmap) {
+	for (std::list<std::shared_ptr<const MyMipmap> >::iterator it = gMipmapCache.begin(); it != gMipmapCache.end(); ++it) {
+		if ((*it)->matches(ownerID, bitmap)) {
+			// Move to the front, most recently used
+			gMipmapCache.splice(gMipmapCache.begin(), gMipmapCache, it);
+			return gMipmapCache.front();
+		}
+	}
+
+	// Drop any chain the shader built from other pixels before adding the new one
+	Purge(ownerID);
+
+	std::shared_ptr<const MyMipmap> mipmap(new MyMipmap(ownerID, bitmap));
+	gMipmapCache.push_front(mipmap);
+	gMipmapCacheBytes += mipmap->bytes();
+
+	// Evict the least recently used chains, but always keep the one we just built
+	while (gMipmapCacheBytes > gMipmapCacheBudget && gMipmapCache.size() > 1) {
+		gMipmapCacheBytes -= gMipmapCache.back()->bytes();
+		gMipmapCache.pop_back();
+	}
+	return mipmap;
+}
+
+void MyMipmap::Purge(const GBitmap& bitmap) {
+	std::list<std::shared_ptr<const MyMipmap> >::iterator it = gMipmapCache.begin();
+	while (it != gMipmapCache.end()) {
+		if ((*it)->pixels == bitmap.fPixels) {
+			gMipmapCacheBytes -= (*it)->bytes();
+			it = gMipmapCache.erase(it);
+		} else {
+			++it;
+		}
+	}
+}
+
+void MyMipmap::Purge(uint32_t ownerID) {
+	std::list<std::shared_ptr<const MyMipmap> >::iterator it = gMipmapCache.begin();
+	while (it != gMipmapCache.end()) {
+		if ((*it)->ownerID == ownerID) {
+			gMipmapCacheBytes -= (*it)->bytes();
+			it = gMipmapCache.erase(it);
+		} else {
+			++it;
+		}
+	}
+}
+
+void MyMipmap::SetCacheBudget(size_t bytes) {
+	gMipmapCacheBudget = bytes;
+	while (gMipmapCacheBytes > gMipmapCacheBudget && !gMipmapCache.empty()) {
+		gMipmapCacheBytes -= gMipmapCache.back()->bytes();
+		gMipmapCache.pop_back();
+	}
+}
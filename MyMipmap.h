@@ -0,0 +1,77 @@
+/*
+ *  Copyright 2015 Wesley Lo
+ */
+
+#ifndef MyMipmap_DEFINED
+#define MyMipmap_DEFINED
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "GBitmap.h"
+
+/**
+ *  A chain of successively halved copies of a bitmap, each made with a 2x2 box filter on the
+ *  premultiplied pixels. Used when a bitmap is drawn smaller than its size, so that sampling
+ *  reads a level close to the destination size instead of skipping over most of the source.
+ *
+ *  Chains are built lazily and cached for the shader that samples them, keyed by its unique ID
+ *  (see MyShader::uniqueID()), so a bitmap that reuses freed pixels is never matched with the
+ *  levels of the one before it. The cache can't see pixels change, so it must be told with
+ *  Purge(). MyCanvas does this for the bitmap it draws into on every draw, so a bitmap rendered
+ *  with one canvas and mipmapped by another is always current.
+ */
+class MyMipmap {
+public:
+	/**
+	 *  Return the chain the shader with this unique ID cached for the bitmap, building it on
+	 *  first use. Level 0 is the bitmap itself; each following level is half the size of the
+	 *  one before (down to 1x1).
+	 */
+	static std::shared_ptr<const MyMipmap> Find(uint32_t ownerID, const GBitmap&);
+
+	/**
+	 *  Drop any cached chain built from the bitmap's pixels. Call this after changing them other
+	 *  than by drawing into the bitmap with a MyCanvas.
+	 */
+	static void Purge(const GBitmap&);
+
+	/**
+	 *  Drop the chain cached for the shader with this unique ID, when the shader is deleted.
+	 */
+	static void Purge(uint32_t ownerID);
+
+	/**
+	 *  Limit the total memory used by cached levels (the least recently used chains are
+	 *  dropped first).
+	 */
+	static void SetCacheBudget(size_t bytes);
+
+	MyMipmap(uint32_t ownerID, const GBitmap&);
+	~MyMipmap();
+
+	int levelCount() const { return levels.size(); }
+
+	const GBitmap& level(int index) const { return levels[index]; }
+
+	/**
+	 *  Pick the level to sample when one device pixel covers [scale] bitmap pixels.
+	 */
+	int chooseLevel(float scale) const;
+
+	size_t bytes() const { return byteCount; }
+
+protected:
+	std::vector<GBitmap> levels;
+	size_t byteCount = 0;
+
+	// The shader the chain is cached for, and the bitmap it was built from
+	uint32_t ownerID;
+	const GPixel* pixels;
+	int width, height;
+	size_t rowBytes;
+
+	bool matches(uint32_t ownerID, const GBitmap&) const;
+};
+
+#endif
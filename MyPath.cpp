@@ -0,0 +1,213 @@
+/*
+ *  Copyright 2015 Wesley Lo
+ */
+
+#include <algorithm>
+#include <cmath>
+#include "MyPath.h"
+
+// Flattened curves stay within this many device pixels of the true curve
+static const float kFlattenTolerance = 0.25f;
+
+// More lines than this per curve would only matter for curves far off the device
+static const int kMaxCurveLines = 256;
+
+static inline float length(float x, float y) {
+	return sqrtf(x * x + y * y);
+}
+
+// A curve whose control points stray deviation from their chord is within
+// deviation / n^2 of n lines through points evenly spaced in t
+static int countLines(float deviation) {
+	float lines = ceilf(sqrtf(deviation / kFlattenTolerance));
+	if (!(lines >= 1))
+		return 1;
+	return (int) std::min(lines, (float) kMaxCurveLines);
+}
+
+// Add the edge, or the same edge going the other way
+static inline void addEdge(MyRasterizer& rasterizer, const GPoint& p0, const GPoint& p1, bool reversed) {
+	if (reversed)
+		rasterizer.addDeviceEdge(p1, p0);
+	else
+		rasterizer.addDeviceEdge(p0, p1);
+}
+
+static void flattenQuad(const GPoint& p0, const GPoint& p1, const GPoint& p2, MyRasterizer& rasterizer,
+		bool reversed) {
+	// The second difference, p0 - 2 p1 + p2, bounds how far the curve bends off the chord
+	float deviation = length(p0.fX - 2 * p1.fX + p2.fX, p0.fY - 2 * p1.fY + p2.fY) / 4;
+	int lines = countLines(deviation);
+
+	GPoint last = p0;
+	for (int i = 1; i < lines; ++i) {
+		float t = (float) i / lines;
+		float s = 1 - t;
+		GPoint p = GPoint::Make(s * s * p0.fX + 2 * s * t * p1.fX + t * t * p2.fX,
+				s * s * p0.fY + 2 * s * t * p1.fY + t * t * p2.fY);
+		addEdge(rasterizer, last, p, reversed);
+		last = p;
+	}
+	addEdge(rasterizer, last, p2, reversed);
+}
+
+static void flattenCubic(const GPoint& p0, const GPoint& p1, const GPoint& p2, const GPoint& p3,
+		MyRasterizer& rasterizer, bool reversed) {
+	float deviation = std::max(length(p0.fX - 2 * p1.fX + p2.fX, p0.fY - 2 * p1.fY + p2.fY),
+			length(p1.fX - 2 * p2.fX + p3.fX, p1.fY - 2 * p2.fY + p3.fY)) * 3 / 4;
+	int lines = countLines(deviation);
+
+	GPoint last = p0;
+	for (int i = 1; i < lines; ++i) {
+		float t = (float) i / lines;
+		float s = 1 - t;
+		float a = s * s * s, b = 3 * s * s * t, c = 3 * s * t * t, d = t * t * t;
+		GPoint p = GPoint::Make(a * p0.fX + b * p1.fX + c * p2.fX + d * p3.fX,
+				a * p0.fY + b * p1.fY + c * p2.fY + d * p3.fY);
+		addEdge(rasterizer, last, p, reversed);
+		last = p;
+	}
+	addEdge(rasterizer, last, p3, reversed);
+}
+
+void MyPath::injectMoveTo() {
+	if (verbs.empty()) {
+		moveTo(GPoint::Make(0, 0));
+		return;
+	}
+	if (verbs.back() != kCloseVerb)
+		return;
+
+	// Start again where the closed contour started (a copy, as moveTo() grows points)
+	GPoint start = points[contourStart];
+	moveTo(start);
+}
+
+MyPath& MyPath::moveTo(const GPoint& p) {
+	contourStart = points.size();
+	verbs.push_back(kMoveVerb);
+	points.push_back(p);
+	return *this;
+}
+
+MyPath& MyPath::lineTo(const GPoint& p) {
+	injectMoveTo();
+	verbs.push_back(kLineVerb);
+	points.push_back(p);
+	return *this;
+}
+
+MyPath& MyPath::quadTo(const GPoint& control, const GPoint& end) {
+	injectMoveTo();
+	verbs.push_back(kQuadVerb);
+	points.push_back(control);
+	points.push_back(end);
+	return *this;
+}
+
+MyPath& MyPath::cubicTo(const GPoint& control0, const GPoint& control1, const GPoint& end) {
+	injectMoveTo();
+	verbs.push_back(kCubicVerb);
+	points.push_back(control0);
+	points.push_back(control1);
+	points.push_back(end);
+	return *this;
+}
+
+MyPath& MyPath::close() {
+	if (!verbs.empty() && verbs.back() != kCloseVerb)
+		verbs.push_back(kCloseVerb);
+	return *this;
+}
+
+MyPath& MyPath::addOval(const GRect& rect) {
+	// The cubic closest to a quarter circle puts its control points this far along the tangents
+	const float kQuarterCircle = 0.5522847f;
+	float cx = (rect.fLeft + rect.fRight) / 2;
+	float cy = (rect.fTop + rect.fBottom) / 2;
+	float rx = (rect.fRight - rect.fLeft) / 2;
+	float ry = (rect.fBottom - rect.fTop) / 2;
+	float kx = rx * kQuarterCircle;
+	float ky = ry * kQuarterCircle;
+
+	moveTo(cx + rx, cy);
+	cubicTo(GPoint::Make(cx + rx, cy + ky), GPoint::Make(cx + kx, cy + ry), GPoint::Make(cx, cy + ry));
+	cubicTo(GPoint::Make(cx - kx, cy + ry), GPoint::Make(cx - rx, cy + ky), GPoint::Make(cx - rx, cy));
+	cubicTo(GPoint::Make(cx - rx, cy - ky), GPoint::Make(cx - kx, cy - ry), GPoint::Make(cx, cy - ry));
+	cubicTo(GPoint::Make(cx + kx, cy - ry), GPoint::Make(cx + rx, cy - ky), GPoint::Make(cx + rx, cy));
+	return close();
+}
+
+MyPath& MyPath::addRRect(const GRect& rect, const float radii[4]) {
+	const float kQuarterCircle = 0.5522847f;
+	const float l = rect.fLeft, t = rect.fTop, r = rect.fRight, b = rect.fBottom;
+	const float tl = radii[0], tr = radii[1], br = radii[2], bl = radii[3];
+
+	// Clockwise (y down) from the end of the top left corner, each corner a cubic
+	moveTo(l + tl, t);
+	lineTo(r - tr, t);
+	cubicTo(GPoint::Make(r - tr * (1 - kQuarterCircle), t), GPoint::Make(r, t + tr * (1 - kQuarterCircle)),
+			GPoint::Make(r, t + tr));
+	lineTo(r, b - br);
+	cubicTo(GPoint::Make(r, b - br * (1 - kQuarterCircle)), GPoint::Make(r - br * (1 - kQuarterCircle), b),
+			GPoint::Make(r - br, b));
+	lineTo(l + bl, b);
+	cubicTo(GPoint::Make(l + bl * (1 - kQuarterCircle), b), GPoint::Make(l, b - bl * (1 - kQuarterCircle)),
+			GPoint::Make(l, b - bl));
+	lineTo(l, t + tl);
+	cubicTo(GPoint::Make(l, t + tl * (1 - kQuarterCircle)), GPoint::Make(l + tl * (1 - kQuarterCircle), t),
+			GPoint::Make(l + tl, t));
+	return close();
+}
+
+void MyPath::reset() {
+	verbs.clear();
+	points.clear();
+	contourStart = 0;
+}
+
+bool MyPath::isEmpty() const {
+	return verbs.empty();
+}
+
+void MyPath::addTo(MyRasterizer& rasterizer, bool reversed) const {
+	// The contour's start and the end of its last segment, in device space
+	GPoint start = GPoint::Make(0, 0);
+	GPoint last = start;
+	const GPoint* p = points.data();
+	for (size_t i = 0; i < verbs.size(); ++i) {
+		switch (verbs[i]) {
+		case kMoveVerb:
+			addEdge(rasterizer, last, start, reversed);
+			start = last = rasterizer.mapToDevice(p[0]);
+			p += 1;
+			break;
+		case kLineVerb: {
+			GPoint end = rasterizer.mapToDevice(p[0]);
+			addEdge(rasterizer, last, end, reversed);
+			last = end;
+			p += 1;
+			break;
+		}
+		case kQuadVerb: {
+			GPoint end = rasterizer.mapToDevice(p[1]);
+			flattenQuad(last, rasterizer.mapToDevice(p[0]), end, rasterizer, reversed);
+			last = end;
+			p += 2;
+			break;
+		}
+		case kCubicVerb: {
+			GPoint end = rasterizer.mapToDevice(p[2]);
+			flattenCubic(last, rasterizer.mapToDevice(p[0]), rasterizer.mapToDevice(p[1]), end, rasterizer, reversed);
+			last = end;
+			p += 3;
+			break;
+		}
+		case kCloseVerb:
+			addEdge(rasterizer, last, start, reversed);
+			last = start;
+			break;
+		}
+	}
+	addEdge(rasterizer, last, start, reversed);
+}
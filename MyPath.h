@@ -0,0 +1,72 @@
+/*
+ *  Copyright 2015 Wesley Lo
+ */
+
+#ifndef MyPath_DEFINED
+#define MyPath_DEFINED
+
+#include <vector>
+#include "GPoint.h"
+#include "GRect.h"
+#include "MyRasterizer.h"
+
+/**
+ *  A shape made of contours of lines, quadratic and cubic Beziers, in local space. Each
+ *  contour starts with moveTo(); drawing into a contour before any moveTo() starts it at the
+ *  origin, and after close() at the start of the contour just closed. Filled, every contour is
+ *  closed whether or not close() was called, and overlaps are resolved with nonzero winding.
+ */
+class MyPath {
+public:
+	MyPath& moveTo(const GPoint&);
+	MyPath& lineTo(const GPoint&);
+	MyPath& quadTo(const GPoint& control, const GPoint& end);
+	MyPath& cubicTo(const GPoint& control0, const GPoint& control1, const GPoint& end);
+	MyPath& close();
+
+	/**
+	 *  Add the oval inscribed in rect as a closed contour of four cubics, clockwise from its
+	 *  right end (y down). The cubics stray under 0.03% of the radius from the true ellipse.
+	 */
+	MyPath& addOval(const GRect&);
+
+	/**
+	 *  Add the rect with its corners rounded by radii (top left, top right, bottom right, bottom
+	 *  left) as a closed contour, clockwise (y down). The radii must already fit the rect.
+	 */
+	MyPath& addRRect(const GRect&, const float radii[4]);
+
+	MyPath& moveTo(float x, float y) { return moveTo(GPoint::Make(x, y)); }
+	MyPath& lineTo(float x, float y) { return lineTo(GPoint::Make(x, y)); }
+
+	void reset();
+	bool isEmpty() const;
+
+	/**
+	 *  Add the path's edges to the rasterizer. Curves are flattened in device space, into as
+	 *  few lines as keep within a quarter of a pixel of the curve: the number of lines grows
+	 *  with the square root of how far the control points bend away from the chord.
+	 *
+	 *  reversed adds every edge going the other way, so the path cuts a hole in (rather than
+	 *  adds to) a shape wound the way it is.
+	 */
+	void addTo(MyRasterizer&, bool reversed = false) const;
+
+private:
+	enum Verb {
+		kMoveVerb,
+		kLineVerb,
+		kQuadVerb,
+		kCubicVerb,
+		kCloseVerb
+	};
+
+	std::vector<Verb> verbs;
+	std::vector<GPoint> points; // the points each verb adds (1, 1, 2, 3 or 0 of them)
+	size_t contourStart = 0;    // the index in points of the last moveTo()
+
+	// Start a contour if the next segment doesn't have one to go in
+	void injectMoveTo();
+};
+
+#endif
@@ -0,0 +1,315 @@
+/*
+ *  Copyright 2015 Wesley Lo
+ */
+
+#include "MyBlendKernels.h"
+#include "MyPipeline.h"
+
+// Scale a premultiplied pixel by scale / 256, two channels at a time
+static inline GPixel scalePixel(GPixel pixel, uint32_t scale) {
+	const uint32_t mask = 0x00FF00FF;
+	uint32_t rb = ((pixel & mask) * scale >> 8) & mask;
+	uint32_t ag = (((pixel >> 8) & mask) * scale) & ~mask;
+	return rb | ag;
+}
+
+// Scale each premultiplied pixel by coverage / 255
+static void applyCoverage(GPixel pixels[], const uint8_t coverage[], int count) {
+	for (int i = 0; i < count; ++i) {
+		// Map [0, 255] onto [0, 256] so full coverage leaves the pixel unchanged
+		pixels[i] = scalePixel(pixels[i], coverage[i] + (coverage[i] >> 7));
+	}
+}
+
+// The alpha stage; context is the scale in [0, 256] itself, not a pointer, so the stage stays
+// valid when the pipeline is copied or moved
+static void scaleByAlpha(const void* context, GPixel pixels[], int count) {
+	const uint32_t scale = (uint32_t) (uintptr_t) context;
+	for (int i = 0; i < count; ++i) {
+		pixels[i] = scalePixel(pixels[i], scale);
+	}
+}
+
+// Move each dst pixel towards the blended pixel by coverage / 255
+static void lerpByCoverage(GPixel dst_row[], const GPixel blended[], const uint8_t coverage[], int count) {
+	const uint32_t mask = 0x00FF00FF;
+	for (int i = 0; i < count; ++i) {
+		uint32_t w = coverage[i] + (coverage[i] >> 7);
+		uint32_t d = dst_row[i];
+		uint32_t b = blended[i];
+		uint32_t rb = (((d & mask) * (256 - w) + (b & mask) * w) >> 8) & mask;
+		uint32_t ag = (((d >> 8) & mask) * (256 - w) + ((b >> 8) & mask) * w) & ~mask;
+		dst_row[i] = rb | ag;
+	}
+}
+
+// Blend src into dst_row, each result only counting for coverage[i] / 255 of its pixel
+template <MyBlendMode mode>
+static void blendRowWithCoverage(GPixel dst_row[], const GPixel src[], const uint8_t coverage[], int count) {
+	GPixel chunk[MyPipeline::kChunkSize];
+	for (int i = 0; i < count; i += MyPipeline::kChunkSize) {
+		int n = std::min((int) MyPipeline::kChunkSize, count - i);
+		if (mode == MyBlendMode::kSrcOver) {
+			// Scaling the source by coverage is the same as blending and then lerping by it
+			memcpy(chunk, &src[i], n * sizeof(GPixel));
+			applyCoverage(chunk, &coverage[i], n);
+			blendRow<mode>(&dst_row[i], chunk, n);
+		} else {
+			memcpy(chunk, &dst_row[i], n * sizeof(GPixel));
+			blendRow<mode>(chunk, &src[i], n);
+			lerpByCoverage(&dst_row[i], chunk, &coverage[i], n);
+		}
+	}
+}
+
+/**
+ *  Blits spans for draws with a known blend mode, source kind and coverage, and no color
+ *  stages. Every decision about the draw is a template argument, so each instantiation is a
+ *  straight loop over the span.
+ */
+template <MyBlendMode mode, MyPipeline::SourceKind kind, bool hasCoverage>
+struct MyBlitter {
+	static void BlitSpan(MyPipeline& pipeline, int x, int y, int count, const uint8_t coverage[]) {
+		GPixel* dst_row = pipeline.dst.getAddr(x, y);
+		if (kind == MyPipeline::kColorSource) {
+			BlitColor(dst_row, pipeline.color, count, coverage);
+			return;
+		}
+
+		GPixel src[MyPipeline::kMaxSpan];
+		if (kind == MyPipeline::kShaderSource) {
+			pipeline.shader->shadeRow(x, y, count, src);
+			BlitRow(dst_row, src, count, coverage);
+			return;
+		}
+
+		MyShader::Run runs[MyShader::kMaxRuns];
+		int runCount = pipeline.myShader->shadeSpan(x, y, count, src, runs);
+		int offset = 0;
+		for (int i = 0; i < runCount; ++i) {
+			const uint8_t* runCoverage = hasCoverage ? &coverage[offset] : NULL;
+			if (runs[i].isConstant)
+				BlitColor(&dst_row[offset], runs[i].color, runs[i].count, runCoverage);
+			else
+				BlitRow(&dst_row[offset], &src[offset], runs[i].count, runCoverage);
+			offset += runs[i].count;
+		}
+	}
+
+	static inline void BlitRow(GPixel dst_row[], const GPixel src[], int count, const uint8_t coverage[]) {
+		if (hasCoverage)
+			blendRowWithCoverage<mode>(dst_row, src, coverage, count);
+		else
+			blendRow<mode>(dst_row, src, count);
+	}
+
+	static inline void BlitColor(GPixel dst_row[], GPixel color, int count, const uint8_t coverage[]) {
+		if (!hasCoverage) {
+			blendColor<mode>(dst_row, color, count);
+			return;
+		}
+
+		GPixel chunk[MyPipeline::kChunkSize];
+		std::fill_n(chunk, std::min(count, (int) MyPipeline::kChunkSize), color);
+		for (int i = 0; i < count; i += MyPipeline::kChunkSize) {
+			blendRowWithCoverage<mode>(&dst_row[i], chunk, &coverage[i], std::min(count - i, (int) MyPipeline::kChunkSize));
+		}
+	}
+};
+
+static GPixel premultiply(const GColor& color) {
+	GColor pinned = color.pinToUnit();
+	float a = pinned.fA * 255.9999f;
+	return GPixel_PackARGB((int) a, (int) (pinned.fR * a), (int) (pinned.fG * a), (int) (pinned.fB * a));
+}
+
+bool MyPipeline::SolidPixel(const GColor& color, MyBlendMode mode, GPixel* pixel) {
+	// The same cases blendColor() fills without reading dst
+	*pixel = mode == MyBlendMode::kClear ? 0 : premultiply(color);
+	return mode == MyBlendMode::kClear || mode == MyBlendMode::kSrc
+			|| (mode == MyBlendMode::kSrcOver && GPixel_GetA(*pixel) == 255);
+}
+
+MyPipeline::MyPipeline(const GBitmap& dst, const GColor& color, MyBlendMode mode) {
+	this->dst = dst;
+	this->color = premultiply(color);
+	setBlendMode(mode);
+	chooseBlitters();
+}
+
+MyPipeline::MyPipeline(const GBitmap& dst, GShader* shader, MyBlendMode mode) {
+	this->dst = dst;
+	setBlendMode(mode);
+	this->shader = shader;
+	this->myShader = dynamic_cast<MyShader*>(shader);
+	sourceKind = myShader ? kRunShaderSource : kShaderSource;
+	chooseBlitters();
+}
+
+void MyPipeline::setBlendMode(MyBlendMode mode) {
+	blendMode = mode;
+	blendRowProc = MyBlend_RowProc(mode);
+	blendColorProc = MyBlend_ColorProc(mode);
+}
+
+#define MY_BLITTERS_FOR_KIND(mode, kind) \
+	{ MyBlitter<MyBlendMode::mode, kind, false>::BlitSpan, MyBlitter<MyBlendMode::mode, kind, true>::BlitSpan }
+#define MY_BLITTERS(mode) \
+	{ MY_BLITTERS_FOR_KIND(mode, kColorSource), MY_BLITTERS_FOR_KIND(mode, kShaderSource), \
+			MY_BLITTERS_FOR_KIND(mode, kRunShaderSource) }
+
+void MyPipeline::chooseBlitters() {
+	if (!stages.empty()) {
+		spanProc = coverageSpanProc = RunStaged;
+		return;
+	}
+
+	// Indexed by [MyBlendMode][SourceKind][hasCoverage]
+	static const SpanProc blitters[][kSourceKindCount][2] = {
+		MY_BLITTERS(kClear), MY_BLITTERS(kSrc), MY_BLITTERS(kDst), MY_BLITTERS(kSrcOver),
+		MY_BLITTERS(kDstOver), MY_BLITTERS(kSrcIn), MY_BLITTERS(kDstIn), MY_BLITTERS(kSrcOut),
+		MY_BLITTERS(kDstOut), MY_BLITTERS(kSrcATop), MY_BLITTERS(kDstATop), MY_BLITTERS(kXor),
+		MY_BLITTERS(kMultiply), MY_BLITTERS(kScreen), MY_BLITTERS(kDarken), MY_BLITTERS(kLighten),
+		MY_BLITTERS(kDifference), MY_BLITTERS(kExclusion),
+	};
+	static_assert(sizeof(blitters) / sizeof(blitters[0]) == (int) MyBlendMode::kLastMode + 1,
+			"blitters for every blend mode");
+
+	spanProc = blitters[(int) blendMode][sourceKind][0];
+	coverageSpanProc = blitters[(int) blendMode][sourceKind][1];
+}
+
+void MyPipeline::addStage(Stage proc, const void* context) {
+	StageRec stage = { proc, context };
+	stages.push_back(stage);
+	chooseBlitters();
+}
+
+void MyPipeline::setAlpha(float alpha) {
+	unsigned alphaScale = (unsigned) (std::max(0.0f, std::min(alpha, 1.0f)) * 256 + 0.5f);
+	if (alphaScale == 256)
+		return;
+
+	if (!shader) {
+		color = scalePixel(color, alphaScale);
+		return;
+	}
+
+	StageRec stage = { scaleByAlpha, (const void*) (uintptr_t) alphaScale };
+	stages.insert(stages.begin(), stage);
+	chooseBlitters();
+}
+
+bool MyPipeline::isRowInvariant() const {
+	return !shader || (myShader && myShader->isRowInvariant());
+}
+
+void MyPipeline::run(int x, int y, int count, const uint8_t coverage[]) {
+	if (count <= 0)
+		return;
+
+	for (int i = 0; i < count; i += kMaxSpan) {
+		int n = std::min((int) kMaxSpan, count - i);
+		if (coverage)
+			coverageSpanProc(*this, x + i, y, n, &coverage[i]);
+		else
+			spanProc(*this, x + i, y, n, NULL);
+	}
+}
+
+void MyPipeline::RunStaged(MyPipeline& pipeline, int x, int y, int count, const uint8_t coverage[]) {
+	GPixel src[kMaxSpan];
+	MyShader::Run runs[MyShader::kMaxRuns];
+	int runCount = pipeline.shadeSource(x, y, count, src, runs);
+	pipeline.blendRuns(pipeline.dst.getAddr(x, y), src, runs, runCount, coverage);
+}
+
+void MyPipeline::runRect(int left, int top, int right, int bottom) {
+	if (left >= right || top >= bottom)
+		return;
+
+	if (!isRowInvariant()) {
+		for (int y = top; y < bottom; ++y) {
+			run(left, y, right - left);
+		}
+		return;
+	}
+
+	// Every row is the same: shade one (kMaxSpan columns at a time) and only blend it into the rest
+	GPixel src[kMaxSpan];
+	MyShader::Run runs[MyShader::kMaxRuns];
+	for (int x = left; x < right; x += kMaxSpan) {
+		int runCount = shadeSource(x, top, std::min((int) kMaxSpan, right - x), src, runs);
+		for (int y = top; y < bottom; ++y) {
+			blendRuns(dst.getAddr(x, y), src, runs, runCount, NULL);
+		}
+	}
+}
+
+int MyPipeline::shadeSource(int x, int y, int count, GPixel src[], MyShader::Run runs[MyShader::kMaxRuns]) {
+	if (!shader) {
+		runs[0].count = count;
+		runs[0].isConstant = true;
+		runs[0].color = color;
+		return 1;
+	}
+
+	if (myShader)
+		return myShader->shadeSpan(x, y, count, src, runs);
+
+	shader->shadeRow(x, y, count, src);
+	runs[0].count = count;
+	runs[0].isConstant = false;
+	runs[0].color = 0;
+	return 1;
+}
+
+void MyPipeline::blendRuns(GPixel dst_row[], const GPixel src[], const MyShader::Run runs[], int runCount,
+		const uint8_t coverage[]) {
+	int offset = 0;
+	for (int i = 0; i < runCount; ++i) {
+		blendSource(&dst_row[offset], &src[offset], runs[i], coverage ? &coverage[offset] : NULL);
+		offset += runs[i].count;
+	}
+}
+
+void MyPipeline::blendSource(GPixel dst_row[], const GPixel src[], const MyShader::Run& run, const uint8_t coverage[]) {
+	if (run.isConstant && !coverage) {
+		// Stages treat pixels independently, so transform the color once and blend it as a solid
+		GPixel runColor = run.color;
+		for (size_t s = 0; s < stages.size(); ++s) {
+			stages[s].proc(stages[s].context, &runColor, 1);
+		}
+		blendColorProc(dst_row, runColor, run.count);
+		return;
+	}
+
+	if (stages.empty() && !coverage) {
+		blendRowProc(dst_row, src, run.count);
+		return;
+	}
+
+	GPixel chunk[kChunkSize];
+	for (int i = 0; i < run.count; i += kChunkSize) {
+		int n = std::min((int) kChunkSize, run.count - i);
+		if (run.isConstant)
+			std::fill_n(chunk, n, run.color);
+		else
+			memcpy(chunk, &src[i], n * sizeof(GPixel));
+
+		for (size_t s = 0; s < stages.size(); ++s) {
+			stages[s].proc(stages[s].context, chunk, n);
+		}
+		if (!coverage) {
+			blendRowProc(&dst_row[i], chunk, n);
+		} else if (blendMode == MyBlendMode::kSrcOver) {
+			applyCoverage(chunk, &coverage[i], n);
+			blendRowProc(&dst_row[i], chunk, n);
+		} else {
+			GPixel blended[kChunkSize];
+			memcpy(blended, &dst_row[i], n * sizeof(GPixel));
+			blendRowProc(blended, chunk, n);
+			lerpByCoverage(&dst_row[i], blended, &coverage[i], n);
+		}
+	}
+}
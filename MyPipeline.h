@@ -0,0 +1,145 @@
+/*
+ *  Copyright 2015 Wesley Lo
+ */
+
+#ifndef MyPipeline_DEFINED
+#define MyPipeline_DEFINED
+
+#include <cstdint>
+#include <vector>
+#include "GBitmap.h"
+#include "GColor.h"
+#include "GShader.h"
+#include "MyBlend.h"
+#include "MyShader.h"
+
+/**
+ *  Turns source colors into destination pixels for one draw. A pipeline is built once per draw
+ *  from the canvas state and then run over each span the draw covers, chaining:
+ *
+ *      source (solid color or shader) -> color stages -> coverage -> blend mode
+ *
+ *  The source is shaded a span at a time, so shaders keep their span level shortcuts (constant
+ *  runs, reused filter rows). The other stages run over chunks of kChunkSize pixels that stay in
+ *  L1, so each destination pixel is read and written once however many stages there are.
+ *
+ *  Draws without color stages are blitted by a span function specialized at compile time for
+ *  the blend mode, the kind of source and whether there is coverage (see MyBlitter in
+ *  MyPipeline.cpp), picked once when the pipeline is built. Inside a span it makes no virtual
+ *  calls beyond shading the source, and doesn't branch on the draw's state.
+ */
+class MyPipeline {
+public:
+	enum {
+		kChunkSize = 64,
+
+		// The longest span the blitters are given; run() splits longer ones, so the source can
+		// be shaded into a fixed buffer on the stack
+		kMaxSpan = 256
+	};
+
+	/**
+	 *  Where the source colors come from. A MyShader is asked for runs with shadeSpan(); any
+	 *  other shader is shaded with shadeRow().
+	 */
+	enum SourceKind {
+		kColorSource,
+		kShaderSource,
+		kRunShaderSource,
+		kSourceKindCount
+	};
+
+	/**
+	 *  A color stage: transform count premultiplied pixels in place. A stage must treat each
+	 *  pixel independently, so a constant run can be transformed once for all of its pixels.
+	 */
+	typedef void (*Stage)(const void* context, GPixel pixels[], int count);
+
+	/**
+	 *  Blend a solid color into dst.
+	 */
+	MyPipeline(const GBitmap& dst, const GColor&, MyBlendMode = MyBlendMode::kSrcOver);
+
+	/**
+	 *  Blend the shader's colors into dst. The caller must already have set the shader's context
+	 *  for this draw.
+	 */
+	MyPipeline(const GBitmap& dst, GShader*, MyBlendMode = MyBlendMode::kSrcOver);
+
+	/**
+	 *  True if blending color with mode sets each fully covered pixel to the same value whatever
+	 *  was there (transparent for kClear, the color for kSrc, an opaque color for kSrcOver), and
+	 *  so pixel could be stored in place of running a pipeline without color stages.
+	 */
+	static bool SolidPixel(const GColor&, MyBlendMode, GPixel* pixel);
+
+	/**
+	 *  Append a color stage. Stages run after the source, in the order they were added.
+	 */
+	void addStage(Stage, const void* context);
+
+	/**
+	 *  Multiply the source's colors by alpha (pinned to [0, 1]) before they are blended. A solid
+	 *  color is scaled once here; a shader's colors are scaled by a stage that runs ahead of any
+	 *  other, and only once per constant run. An alpha of 1 costs nothing.
+	 */
+	void setAlpha(float alpha);
+
+	/**
+	 *  True if every row of the draw has the same source colors (a solid color, or a shader
+	 *  reporting MyShader::isRowInvariant()).
+	 */
+	bool isRowInvariant() const;
+
+	/**
+	 *  Run the pipeline over device pixels [x, y] ... [x + count - 1, y], which must lie inside
+	 *  dst. If coverage is not NULL, each result only counts for coverage[i] / 255 of the pixel:
+	 *  dst' = dst + (blend(src, dst) - dst) * coverage[i] / 255.
+	 */
+	void run(int x, int y, int count, const uint8_t coverage[] = NULL);
+
+	/**
+	 *  Run the pipeline over [left, right) x [top, bottom), already clipped to dst. Row invariant
+	 *  sources are shaded once for the whole rect.
+	 */
+	void runRect(int left, int top, int right, int bottom);
+
+private:
+	template <MyBlendMode, SourceKind, bool> friend struct MyBlitter;
+
+	typedef void (*SpanProc)(MyPipeline&, int x, int y, int count, const uint8_t coverage[]);
+
+	struct StageRec {
+		Stage proc;
+		const void* context;
+	};
+
+	GBitmap dst;
+	GPixel color = 0;
+	GShader* shader = NULL;
+	MyShader* myShader = NULL; // shader, when it supports the MyShader queries
+	std::vector<StageRec> stages;
+	SourceKind sourceKind = kColorSource;
+	MyBlendMode blendMode;
+	MyBlendRowProc blendRowProc;
+	MyBlendColorProc blendColorProc;
+
+	// The blitters picked for this draw, for spans without and with coverage
+	SpanProc spanProc;
+	SpanProc coverageSpanProc;
+
+	void setBlendMode(MyBlendMode);
+
+	void chooseBlitters();
+
+	// The general path, used when the draw has color stages
+	static void RunStaged(MyPipeline&, int x, int y, int count, const uint8_t coverage[]);
+
+	int shadeSource(int x, int y, int count, GPixel src[], MyShader::Run runs[MyShader::kMaxRuns]);
+
+	void blendRuns(GPixel dst_row[], const GPixel src[], const MyShader::Run runs[], int runCount, const uint8_t coverage[]);
+
+	void blendSource(GPixel dst_row[], const GPixel src[], const MyShader::Run& run, const uint8_t coverage[]);
+};
+
+#endif
@@ -0,0 +1,205 @@
+/*
+ *  Copyright 2015 Wesley Lo
+ */
+
+#include <algorithm>
+#include <cmath>
+#include "MyMatrix.h"
+#include "MyRasterizer.h"
+
+MyRasterizer::MyRasterizer(int width, int height, const float ctm[6]) {
+	this->width = width;
+	this->height = height;
+	std::copy(ctm, ctm + 6, this->ctm);
+}
+
+GPoint MyRasterizer::mapToDevice(const GPoint& p) const {
+	return GPoint::Make(ctm[0] * p.fX + ctm[1] * p.fY + ctm[2], ctm[3] * p.fX + ctm[4] * p.fY + ctm[5]);
+}
+
+float MyRasterizer::deviceScale() const {
+	return MyMatrix_MaxScale(ctm);
+}
+
+void MyRasterizer::addEdge(const GPoint& p0, const GPoint& p1) {
+	addDeviceEdge(mapToDevice(p0), mapToDevice(p1));
+}
+
+void MyRasterizer::addDeviceEdge(GPoint p0, GPoint p1) {
+	// Horizontal edges never cross a row's sample line
+	if (p0.fY == p1.fY)
+		return;
+
+	Edge edge;
+	edge.winding = p0.fY < p1.fY ? 1 : -1;
+	if (p0.fY > p1.fY)
+		std::swap(p0, p1);
+	edge.top = p0.fY;
+	edge.bottom = p1.fY;
+	edge.x = p0.fX;
+	edge.dxdy = (p1.fX - p0.fX) / (p1.fY - p0.fY);
+	edge.shape = shape;
+	edges.push_back(edge);
+}
+
+void MyRasterizer::addPolygon(const GPoint pts[], int count) {
+	for (int i = 0; i < count; ++i) {
+		addEdge(pts[i], pts[(i + 1) % count]);
+	}
+}
+
+bool MyRasterizer::deviceBounds(int* left, int* top, int* right, int* bottom) const {
+	if (edges.empty())
+		return false;
+
+	float minX = edges[0].x, maxX = edges[0].x;
+	float minY = edges[0].top, maxY = edges[0].bottom;
+	for (size_t i = 0; i < edges.size(); ++i) {
+		float x1 = edges[i].x + (edges[i].bottom - edges[i].top) * edges[i].dxdy;
+		minX = std::min(minX, std::min(edges[i].x, x1));
+		maxX = std::max(maxX, std::max(edges[i].x, x1));
+		minY = std::min(minY, edges[i].top);
+		maxY = std::max(maxY, edges[i].bottom);
+	}
+
+	*left = std::max(0, (int) floorf(minX));
+	*top = std::max(0, (int) floorf(minY));
+	*right = std::min(width, (int) ceilf(maxX) + 1);
+	*bottom = std::min(height, (int) ceilf(maxY) + 1);
+	return *left < *right && *top < *bottom;
+}
+
+// floorf is a library call without SSE4.1; the pixels a span covers only need this
+static inline int floorToInt(float x) {
+	int i = (int) x;
+	return i > x ? i - 1 : i;
+}
+
+static inline int ceilToInt(float x) {
+	return -floorToInt(-x);
+}
+
+// Run the pipeline over the pixels whose centers are between x0 and x1
+static inline void fillSpan(MyPipeline& pipeline, float x0, float x1, int y, int width) {
+	int left = std::max(0, floorToInt(x0 + 0.5f));
+	int right = std::min(width, floorToInt(x1 + 0.5f));
+	if (left < right)
+		pipeline.run(left, y, right - left);
+}
+
+static bool crossingBefore(const MyRasterizer::Crossing& a, const MyRasterizer::Crossing& b) {
+	return a.x < b.x;
+}
+
+void MyRasterizer::setShape(int index) {
+	shape = index;
+}
+
+void MyRasterizer::fill(MyPipeline& pipeline) {
+	scan(&pipeline, false);
+}
+
+void MyRasterizer::fillShapes(MyPipeline pipelines[]) {
+	scan(pipelines, true);
+}
+
+void MyRasterizer::scan(MyPipeline pipelines[], bool byShape) {
+	if (edges.empty())
+		return;
+
+	// Rows whose center (y + 0.5) may be inside: top <= y + 0.5 < bottom for some edge
+	float top = edges[0].top, bottom = edges[0].bottom;
+	for (size_t i = 1; i < edges.size(); ++i) {
+		top = std::min(top, edges[i].top);
+		bottom = std::max(bottom, edges[i].bottom);
+	}
+	const int yStart = std::max(0, ceilToInt(top - 0.5f));
+	const int yEnd = std::min(height, ceilToInt(bottom - 0.5f));
+	if (yStart >= yEnd) {
+		edges.clear();
+		return;
+	}
+
+	// Bucket the edges by the first row they cross (a counting sort), keeping the order they
+	// were added in, and so their shapes in order, within each row
+	const int rows = yEnd - yStart;
+	std::vector<int> rowStart(rows + 1, 0);
+	std::vector<int> firstRow(edges.size());
+	for (size_t i = 0; i < edges.size(); ++i) {
+		firstRow[i] = std::max(yStart, ceilToInt(edges[i].top - 0.5f)) - yStart;
+		if (firstRow[i] < rows)
+			++rowStart[firstRow[i] + 1];
+	}
+	for (int r = 0; r < rows; ++r) {
+		rowStart[r + 1] += rowStart[r];
+	}
+	std::vector<const Edge*> starting(rowStart[rows]);
+	std::vector<int> filled(rowStart.begin(), rowStart.end() - 1);
+	for (size_t i = 0; i < edges.size(); ++i) {
+		if (firstRow[i] < rows)
+			starting[filled[firstRow[i]]++] = &edges[i];
+	}
+
+	// The active edges are kept in shape order, so each shape's crossings are together
+	std::vector<const Edge*> active, merged;
+	std::vector<Crossing> crossings;
+	for (int y = yStart; y < yEnd; ++y) {
+		const float center = y + 0.5f;
+		const Edge* const* begin = starting.data() + rowStart[y - yStart];
+		const Edge* const* end = starting.data() + rowStart[y - yStart + 1];
+
+		// Drop the edges that ended before this row, and merge in those starting on it
+		merged.clear();
+		for (size_t i = 0; i < active.size(); ++i) {
+			if (active[i]->bottom <= center)
+				continue;
+			for (; begin < end && (!byShape || (*begin)->shape < active[i]->shape); ++begin) {
+				if ((*begin)->bottom > center)
+					merged.push_back(*begin);
+			}
+			merged.push_back(active[i]);
+		}
+		for (; begin < end; ++begin) {
+			if ((*begin)->bottom > center)
+				merged.push_back(*begin);
+		}
+		active.swap(merged);
+
+		for (size_t i = 0; i < active.size();) {
+			const int shape = byShape ? active[i]->shape : 0;
+			size_t shapeEnd = i + 1;
+			while (shapeEnd < active.size() && (!byShape || active[shapeEnd]->shape == shape)) {
+				++shapeEnd;
+			}
+
+			// Most rows of most shapes (anything convex) cross just two edges of opposite winding
+			if (shapeEnd - i == 2 && active[i]->winding != active[i + 1]->winding) {
+				float x0 = active[i]->x + (center - active[i]->top) * active[i]->dxdy;
+				float x1 = active[i + 1]->x + (center - active[i + 1]->top) * active[i + 1]->dxdy;
+				fillSpan(pipelines[shape], std::min(x0, x1), std::max(x0, x1), y, width);
+				i = shapeEnd;
+				continue;
+			}
+
+			crossings.clear();
+			for (; i < shapeEnd; ++i) {
+				Crossing crossing = { active[i]->x + (center - active[i]->top) * active[i]->dxdy, active[i]->winding };
+				crossings.push_back(crossing);
+			}
+			std::sort(crossings.begin(), crossings.end(), crossingBefore);
+
+			// Fill between the crossings where the winding is nonzero
+			int winding = 0;
+			float spanStart = 0;
+			for (size_t c = 0; c < crossings.size(); ++c) {
+				if (winding == 0)
+					spanStart = crossings[c].x;
+				winding += crossings[c].winding;
+				if (winding == 0)
+					fillSpan(pipelines[shape], spanStart, crossings[c].x, y, width);
+			}
+		}
+	}
+
+	edges.clear();
+}
@@ -0,0 +1,98 @@
+/*
+ *  Copyright 2015 Wesley Lo
+ */
+
+#ifndef MyRasterizer_DEFINED
+#define MyRasterizer_DEFINED
+
+#include <vector>
+#include "GPoint.h"
+#include "MyPipeline.h"
+
+/**
+ *  Collects the edges of any number of closed contours, mapped to device space by a CTM, and
+ *  fills them with the nonzero winding rule in one scan. Overlapping contours (a stroke's
+ *  segments and joins, a shape's pieces) cover each pixel once, however many contain it.
+ *
+ *  Pixels are filled where their center is inside the shape, clipped to the device size.
+ */
+class MyRasterizer {
+public:
+	MyRasterizer(int width, int height, const float ctm[6]);
+
+	/**
+	 *  Add the edge from p0 to p1, both in local space. The edges added must form closed
+	 *  contours, in any order; an edge's direction sets its winding.
+	 */
+	void addEdge(const GPoint& p0, const GPoint& p1);
+
+	/**
+	 *  Add the edge from p0 to p1, already in device space (see mapToDevice()).
+	 */
+	void addDeviceEdge(GPoint p0, GPoint p1);
+
+	/**
+	 *  Add the closed polygon pts[0], pts[1] ... pts[count - 1] (back to pts[0]).
+	 */
+	void addPolygon(const GPoint pts[], int count);
+
+	/**
+	 *  The scale from local space to device space along the CTM's largest axis.
+	 */
+	float deviceScale() const;
+
+	/**
+	 *  Map a point from local space to device space by the CTM.
+	 */
+	GPoint mapToDevice(const GPoint&) const;
+
+	/**
+	 *  The device pixels the edges added so far may touch, clipped to the device. Returns false
+	 *  if there are none.
+	 */
+	bool deviceBounds(int* left, int* top, int* right, int* bottom) const;
+
+	/**
+	 *  Edges added after this belong to shape index (0 until this is called), which must not
+	 *  be less than the last. Each shape is its own set of closed contours, filled on its own by
+	 *  fillShapes().
+	 */
+	void setShape(int index);
+
+	/**
+	 *  Run the pipeline over every pixel inside the contours, then forget the edges. The
+	 *  contours of all the shapes are filled as one.
+	 */
+	void fill(MyPipeline&);
+
+	/**
+	 *  Run pipelines[i] over every pixel inside shape i, for every shape, in one pass over the
+	 *  rows, then forget the edges. Where shapes overlap, a pixel is blended by each shape
+	 *  covering it in the order of their indices.
+	 */
+	void fillShapes(MyPipeline pipelines[]);
+
+	struct Edge {
+		float top, bottom; // device y range, top < bottom
+		float x;           // x at top
+		float dxdy;
+		int winding;       // +1 for edges going down, -1 for edges going up
+		int shape;
+	};
+
+	struct Crossing {
+		float x;
+		int winding;
+	};
+
+private:
+	int width, height;
+	float ctm[6];
+	int shape = 0;
+	std::vector<Edge> edges;
+
+	// Fill the edges, by shape if byShape, and otherwise all with pipelines[0]
+	void scan(MyPipeline pipelines[], bool byShape);
+};
+
+#endif
@@ -0,0 +1,48 @@
+/*
+ *  Copyright 2015 Wesley Lo
+ */
+
+#include <atomic>
+#include "MyShader.h"
+
+static uint32_t NextUniqueID() {
+	static std::atomic<uint32_t> gNextID(1);
+	return gNextID++;
+}
+
+MyShader::MyShader() {
+	id = NextUniqueID();
+}
+
+MyShader::MyShader(const MyShader&) {
+	id = NextUniqueID();
+}
+
+MyShader& MyShader::operator=(const MyShader&) {
+	// The contents change, so this is no longer the shader that was cached under id
+	id = NextUniqueID();
+	return *this;
+}
+
+int MyShader::shadeSpan(int x, int y, int count, GPixel row[], Run runs[kMaxRuns]) {
+	shadeRow(x, y, count, row);
+	return MakeRuns(count, 0, 0, 0, 0, runs);
+}
+
+bool MyShader::isRowInvariant() const {
+	return false;
+}
+
+int MyShader::MakeRuns(int count, int head, GPixel headColor, int tail, GPixel tailColor, Run runs[kMaxRuns]) {
+	int runCount = 0;
+	if (head > 0) {
+		runs[runCount++] = { head, true, headColor };
+	}
+	if (count - head - tail > 0) {
+		runs[runCount++] = { count - head - tail, false, 0 };
+	}
+	if (tail > 0) {
+		runs[runCount++] = { tail, true, tailColor };
+	}
+	return runCount;
+}
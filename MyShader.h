@@ -0,0 +1,73 @@
+/*
+ *  Copyright 2015 Wesley Lo
+ */
+
+#ifndef MyShader_DEFINED
+#define MyShader_DEFINED
+
+#include <cstdint>
+#include "GShader.h"
+
+/**
+ *  Base class for the shaders in this directory. It adds optional queries that let the canvas
+ *  skip shading work; each has a default built on shadeRow(), so subclasses only override the
+ *  ones they can answer cheaply.
+ */
+class MyShader: public GShader {
+public:
+	MyShader();
+
+	/**
+	 *  A copy is a new shader, with its own uniqueID().
+	 */
+	MyShader(const MyShader&);
+	MyShader& operator=(const MyShader&);
+
+	/**
+	 *  Identifies this shader for caches. Every shader gets a new one when it is constructed,
+	 *  and one is never reused, even after its shader is deleted, so a shader built at the
+	 *  address of a deleted one can't be mistaken for it.
+	 */
+	uint32_t uniqueID() const { return id; }
+
+	/**
+	 *  A run of consecutive pixels in a span. If isConstant, every pixel in the run is color and
+	 *  nothing was written to row[] for it. Otherwise the run's pixels were shaded into row[].
+	 */
+	struct Run {
+		int count;
+		bool isConstant;
+		GPixel color;
+	};
+
+	// A span is split into at most a constant head, a shaded middle and a constant tail
+	enum {
+		kMaxRuns = 3
+	};
+
+	/**
+	 *  Like shadeRow(), but report the span [x, y] ... [x + count - 1, y] as runs, in order, that
+	 *  together cover count pixels. row[i] still corresponds to device pixel x + i. Returns the
+	 *  number of runs written to runs[].
+	 */
+	virtual int shadeSpan(int x, int y, int count, GPixel row[], Run runs[kMaxRuns]);
+
+	/**
+	 *  Returns true if, under the CTM given to the last setContext(), the shader's output depends
+	 *  only on x, so every row of a draw is the same. The canvas may then shade a single row and
+	 *  blend it into every scanline.
+	 */
+	virtual bool isRowInvariant() const;
+
+protected:
+	/**
+	 *  Helper for subclasses: describe a span as [head] constant pixels, then [count - head - tail]
+	 *  shaded ones, then [tail] constant pixels, skipping empty runs. Returns the number of runs.
+	 */
+	static int MakeRuns(int count, int head, GPixel headColor, int tail, GPixel tailColor, Run runs[kMaxRuns]);
+
+private:
+	uint32_t id;
+};
+
+#endif
@@ -0,0 +1,161 @@
+/*
+ *  Copyright 2015 Wesley Lo
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <list>
+#include "MyShaderCache.h"
+
+// Most recently used entries first
+static std::list<std::shared_ptr<const MyShaderCache> > gShaderCache;
+static size_t gShaderCacheBytes = 0;
+static size_t gShaderCacheBudget = 16 * 1024 * 1024;
+static int gShaderCacheHits = 0;
+static int gShaderCacheMisses = 0;
+
+// Two rects are baked as one entry only if their union is at most this many times their areas
+// added together, so little of it is shaded for nothing
+static const size_t kMergeFactor = 2;
+
+static void evictToBudget(size_t keep) {
+	while (gShaderCacheBytes > gShaderCacheBudget && gShaderCache.size() > keep) {
+		gShaderCacheBytes -= gShaderCache.back()->bytes();
+		gShaderCache.pop_back();
+	}
+}
+
+MyShaderCache::MyShaderCache(MyShader* shader, const float ctm[6], int left, int top, int right, int bottom,
+		const MyShaderCache* previous) {
+	shaderID = shader->uniqueID();
+	std::copy(ctm, ctm + 6, this->ctm);
+	bounds[0] = left;
+	bounds[1] = top;
+	bounds[2] = right;
+	bounds[3] = bottom;
+
+	baked.fWidth = right - left;
+	baked.fHeight = bottom - top;
+	baked.fRowBytes = baked.fWidth * sizeof(GPixel);
+	baked.fPixels = (GPixel*) malloc(baked.fRowBytes * baked.fHeight);
+
+	valid = shader->setContext(ctm);
+	for (int y = 0; valid && y < baked.fHeight; ++y) {
+		GPixel* row = baked.getAddr(0, y);
+		const int deviceY = top + y;
+		if (!previous || deviceY < previous->bounds[1] || deviceY >= previous->bounds[3]) {
+			shader->shadeRow(left, deviceY, baked.fWidth, row);
+			continue;
+		}
+
+		// Copy what the previous entry already baked, and shade either side of it
+		const int copyLeft = previous->bounds[0];
+		const int copyRight = previous->bounds[2];
+		if (copyLeft > left)
+			shader->shadeRow(left, deviceY, copyLeft - left, row);
+		memcpy(row + (copyLeft - left), previous->baked.getAddr(0, deviceY - previous->bounds[1]),
+				(copyRight - copyLeft) * sizeof(GPixel));
+		if (right > copyRight)
+			shader->shadeRow(copyRight, deviceY, right - copyRight, row + (copyRight - left));
+	}
+
+	// Device pixel (x, y) samples baked pixel (x - left, y - top) with the unscaled copy path
+	const float localMatrix[6] = { 1, 0, (float) left, 0, 1, (float) top };
+	const float identity[6] = { 1, 0, 0, 0, 1, 0 };
+	blit.reset(new MyShaderFromBitmap(baked, localMatrix));
+	blit->setContext(identity);
+}
+
+MyShaderCache::~MyShaderCache() {
+	free(baked.fPixels);
+}
+
+bool MyShaderCache::contains(uint32_t shaderID, const float ctm[6], int left, int top, int right, int bottom) const {
+	return this->shaderID == shaderID && std::equal(ctm, ctm + 6, this->ctm) && left >= bounds[0] && top >= bounds[1]
+			&& right <= bounds[2] && bottom <= bounds[3];
+}
+
+std::shared_ptr<const MyShaderCache> MyShaderCache::Find(MyShader* shader, const float ctm[6], int left, int top,
+		int right, int bottom) {
+	const uint32_t shaderID = shader->uniqueID();
+	for (std::list<std::shared_ptr<const MyShaderCache> >::iterator it = gShaderCache.begin(); it != gShaderCache.end(); ++it) {
+		if ((*it)->contains(shaderID, ctm, left, top, right, bottom)) {
+			// Move to the front, most recently used
+			gShaderCache.splice(gShaderCache.begin(), gShaderCache, it);
+			++gShaderCacheHits;
+			return gShaderCache.front();
+		}
+	}
+
+	++gShaderCacheMisses;
+
+	// Grow an entry for the same shader and CTM to cover both rects, unless much of the union
+	// would be in neither or it doesn't fit in the budget; otherwise bake the rect on its own
+	const size_t area = (size_t) (right - left) * (bottom - top);
+	std::list<std::shared_ptr<const MyShaderCache> >::iterator grow = gShaderCache.end();
+	for (std::list<std::shared_ptr<const MyShaderCache> >::iterator it = gShaderCache.begin(); it != gShaderCache.end(); ++it) {
+		const MyShaderCache& entry = **it;
+		if (entry.shaderID != shaderID || !std::equal(ctm, ctm + 6, entry.ctm))
+			continue;
+
+		const int unionLeft = std::min(left, entry.bounds[0]);
+		const int unionTop = std::min(top, entry.bounds[1]);
+		const int unionRight = std::max(right, entry.bounds[2]);
+		const int unionBottom = std::max(bottom, entry.bounds[3]);
+		const size_t unionArea = (size_t) (unionRight - unionLeft) * (unionBottom - unionTop);
+		const size_t entryArea = (size_t) entry.baked.fWidth * entry.baked.fHeight;
+		if (unionArea <= kMergeFactor * (area + entryArea) && unionArea * sizeof(GPixel) <= gShaderCacheBudget) {
+			grow = it;
+			left = unionLeft;
+			top = unionTop;
+			right = unionRight;
+			bottom = unionBottom;
+			break;
+		}
+	}
+
+	if ((size_t) (right - left) * (bottom - top) * sizeof(GPixel) > gShaderCacheBudget)
+		return NULL;
+
+	// Growing only shades the part of the union the entry doesn't already have
+	const MyShaderCache* previous = grow != gShaderCache.end() ? grow->get() : NULL;
+	std::shared_ptr<const MyShaderCache> entry(new MyShaderCache(shader, ctm, left, top, right, bottom, previous));
+	if (!entry->valid)
+		return NULL;
+
+	if (previous) {
+		gShaderCacheBytes -= previous->bytes();
+		gShaderCache.erase(grow);
+	}
+	gShaderCache.push_front(entry);
+	gShaderCacheBytes += entry->bytes();
+
+	// Evict the least recently used entries, but always keep the one we just baked
+	evictToBudget(1);
+	return entry;
+}
+
+void MyShaderCache::Purge(const MyShader* shader) {
+	std::list<std::shared_ptr<const MyShaderCache> >::iterator it = gShaderCache.begin();
+	while (it != gShaderCache.end()) {
+		if ((*it)->shaderID == shader->uniqueID()) {
+			gShaderCacheBytes -= (*it)->bytes();
+			it = gShaderCache.erase(it);
+		} else {
+			++it;
+		}
+	}
+}
+
+void MyShaderCache::SetCacheBudget(size_t bytes) {
+	gShaderCacheBudget = bytes;
+	evictToBudget(0);
+}
+
+int MyShaderCache::HitCount() {
+	return gShaderCacheHits;
+}
+
+int MyShaderCache::MissCount() {
+	return gShaderCacheMisses;
+}
@@ -0,0 +1,88 @@
+/*
+ *  Copyright 2015 Wesley Lo
+ */
+
+#ifndef MyShaderCache_DEFINED
+#define MyShaderCache_DEFINED
+
+#include <memory>
+#include "GBitmap.h"
+#include "MyShader.h"
+#include "MyShaderFromBitmap.h"
+
+/**
+ *  A shader's colors under one CTM, rasterized over a device space rect. Drawing the same
+ *  shader with the same CTM again (a radial, sweep or composed fill repeated every frame) can
+ *  then copy the baked pixels with the 1:1 bitmap path instead of shading them again.
+ *
+ *  Entries are found by the shader's MyShader::uniqueID() and the exact CTM. Ids are never
+ *  reused, so a new shader can't pick up a deleted one's pixels, but a shader whose output
+ *  changes (for example a bitmap shader whose pixels are rewritten) must be passed to Purge().
+ *  Entries of deleted shaders are only dropped as the budget needs the room, or by Purge().
+ *
+ *  A miss near an entry for the same shader and CTM grows the entry to cover both rects,
+ *  copying the pixels it already has; rects far apart (or too big together) get entries of
+ *  their own.
+ */
+class MyShaderCache {
+public:
+	/**
+	 *  Return baked pixels covering device pixels [left, right) x [top, bottom) of the shader
+	 *  under ctm, rasterizing (and caching) them on a miss. Returns NULL if the rect doesn't fit
+	 *  in the cache budget or the shader can't handle the CTM; the caller should then shade
+	 *  directly.
+	 */
+	static std::shared_ptr<const MyShaderCache> Find(MyShader*, const float ctm[6], int left, int top, int right, int bottom);
+
+	/**
+	 *  Drop every entry baked from the shader.
+	 */
+	static void Purge(const MyShader*);
+
+	/**
+	 *  Limit the total memory used by baked pixels (the least recently used entries are dropped
+	 *  first).
+	 */
+	static void SetCacheBudget(size_t bytes);
+
+	/**
+	 *  The number of Find() calls answered from the cache, and the number that rasterized.
+	 */
+	static int HitCount();
+	static int MissCount();
+
+	/**
+	 *  Bake the rect. previous, if not NULL, is an entry for the same shader and CTM inside the
+	 *  rect, whose pixels are copied instead of shaded again.
+	 */
+	MyShaderCache(MyShader*, const float ctm[6], int left, int top, int right, int bottom,
+			const MyShaderCache* previous = NULL);
+	~MyShaderCache();
+
+	// The baked pixels; pixel (0, 0) is device pixel (left(), top())
+	const GBitmap& bitmap() const { return baked; }
+
+	/**
+	 *  A shader that copies the baked pixels 1:1 into the same device pixels. Its context is
+	 *  already set; don't call setContext() on it.
+	 */
+	GShader* blitShader() const { return blit.get(); }
+
+	int left() const { return bounds[0]; }
+
+	int top() const { return bounds[1]; }
+
+	size_t bytes() const { return baked.fRowBytes * baked.fHeight; }
+
+protected:
+	GBitmap baked;
+	uint32_t shaderID;
+	float ctm[6];
+	int bounds[4]; // left, top, right, bottom
+	bool valid = true; // false if the shader rejected the CTM
+	std::unique_ptr<MyShaderFromBitmap> blit;
+
+	bool contains(uint32_t shaderID, const float ctm[6], int left, int top, int right, int bottom) const;
+};
+
+#endif
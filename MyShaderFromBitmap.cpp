@@ -3,42 +3,577 @@
  */
 
 #include <algorithm>
+#include <cstring>
 #include "MyShaderFromBitmap.h"
+#include "MyMatrix.h"
 
-MyShaderFromBitmap::MyShaderFromBitmap(const GBitmap& bitmap, const float localMatrix[6]) {
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+// Bitmap coordinates are stepped across a span as 16.16 fixed point
+static const int kFixedShift = 16;
+static const int kFixedOne = 1 << kFixedShift;
+
+// Largest coordinate (in pixels) that can be stepped in 16.16 without overflowing
+static const float kFixedMax = 32000;
+
+// Largest tiling period (in pixels) that can be stepped in 16.16: a wrapped position and step
+// are each below the period, so their sum (up to 2 * period) must fit in an int
+static const int kMaxPeriod = 1 << (30 - kFixedShift);
+
+static inline int toFixed(float value) {
+	return (int) floorf(value * kFixedOne);
+}
+
+// Interpolate between two premultiplied pixels, a + (b - a) * w / 256 for w in [0, 256].
+// Works on two channels at once: red/blue and alpha/green each sit in their own 16 bit lanes.
+static inline GPixel lerpPixel(GPixel a, GPixel b, unsigned w) {
+	const uint32_t mask = 0x00FF00FF;
+	uint32_t rb = (((a & mask) * (256 - w) + (b & mask) * w) >> 8) & mask;
+	uint32_t ag = (((a >> 8) & mask) * (256 - w) + ((b >> 8) & mask) * w) & ~mask;
+	return rb | ag;
+}
+
+#ifdef __AVX2__
+// Interpolate eight pairs of premultiplied pixels, each with its own weight in [0, 256]
+// (one per 32 bit lane), by widening to 16 bits per channel.
+static inline __m256i lerpPixels8(__m256i a, __m256i b, __m256i w) {
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i one = _mm256_set1_epi16(256);
+
+	// Spread each pixel's weight over its four 16 bit channels, matching unpacklo/hi_epi8
+	__m256i w16 = _mm256_or_si256(w, _mm256_slli_epi32(w, 16));
+	__m256i w1Lo = _mm256_unpacklo_epi32(w16, w16);
+	__m256i w1Hi = _mm256_unpackhi_epi32(w16, w16);
+	__m256i w0Lo = _mm256_sub_epi16(one, w1Lo);
+	__m256i w0Hi = _mm256_sub_epi16(one, w1Hi);
+
+	__m256i lo = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(a, zero), w0Lo),
+			_mm256_mullo_epi16(_mm256_unpacklo_epi8(b, zero), w1Lo));
+	__m256i hi = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(a, zero), w0Hi),
+			_mm256_mullo_epi16(_mm256_unpackhi_epi8(b, zero), w1Hi));
+	return _mm256_packus_epi16(_mm256_srli_epi16(lo, 8), _mm256_srli_epi16(hi, 8));
+}
+#endif
+
+// Blend two rows of pixels with the same weight, w in [0, 256]
+static void lerpRows(const GPixel top[], const GPixel bottom[], unsigned w, int count, GPixel dst_row[]) {
+	int i = 0;
+
+#ifdef __AVX2__
+	const __m256i weight = _mm256_set1_epi32(w);
+	for (; i + 8 <= count; i += 8) {
+		__m256i a = _mm256_loadu_si256((const __m256i*) &top[i]);
+		__m256i b = _mm256_loadu_si256((const __m256i*) &bottom[i]);
+		_mm256_storeu_si256((__m256i*) &dst_row[i], lerpPixels8(a, b, weight));
+	}
+#endif
+
+	for (; i < count; ++i) {
+		dst_row[i] = lerpPixel(top[i], bottom[i], w);
+	}
+}
+
+// Map any pixel coordinate onto the bitmap along one axis
+static inline int tileIndex(int x, int size, MyShaderFromBitmap::TileMode mode) {
+	switch (mode) {
+	case MyShaderFromBitmap::kRepeat:
+		x %= size;
+		return x < 0 ? x + size : x;
+	case MyShaderFromBitmap::kMirror:
+		x %= 2 * size;
+		x = x < 0 ? x + 2 * size : x;
+		return x < size ? x : 2 * size - 1 - x;
+	default:
+		return std::max(0, std::min(x, size - 1));
+	}
+}
+
+// Bring a tiled coordinate into its first period, so pinning it to an int doesn't move it
+static inline float wrapToPeriod(float u, int size, MyShaderFromBitmap::TileMode mode) {
+	if (mode == MyShaderFromBitmap::kClamp)
+		return u;
+	float period = mode == MyShaderFromBitmap::kMirror ? 2.0f * size : size;
+	return u - floorf(u / period) * period;
+}
+
+/**
+ *  Steps one axis of a 16.16 bitmap coordinate across a span. For kRepeat and kMirror the
+ *  position is kept wrapped inside one period (the bitmap size, or twice it when mirroring), so
+ *  it can never overflow however long the span is. Power of two sizes wrap with a mask.
+ */
+struct AxisStepper {
+	MyShaderFromBitmap::TileMode mode;
+	int size;
+	int periodPixels;
+	int periodMask; // periodPixels - 1 when it is a power of two, else 0
+	int f, df;
+	int period; // periodPixels in 16.16
+
+	// Returns false if the span can't be stepped in 16.16
+	bool init(MyShaderFromBitmap::TileMode mode, int size, float start, float step, int count) {
+		this->mode = mode;
+		this->size = size;
+
+		if (mode == MyShaderFromBitmap::kClamp) {
+			if (std::max(fabsf(start), fabsf(start + step * count)) >= kFixedMax)
+				return false;
+			f = toFixed(start);
+			df = toFixed(step);
+			return true;
+		}
+
+		periodPixels = mode == MyShaderFromBitmap::kMirror ? 2 * size : size;
+		if (periodPixels >= kMaxPeriod)
+			return false;
+		periodMask = (periodPixels & (periodPixels - 1)) == 0 ? periodPixels - 1 : 0;
+		period = periodPixels << kFixedShift;
+
+		// The pattern repeats every period, so bring both the start and the step into [0, period)
+		f = toFixed(start - floorf(start / periodPixels) * periodPixels);
+		df = toFixed(step - floorf(step / periodPixels) * periodPixels);
+		f = std::max(0, std::min(f, period - 1));
+		df = std::max(0, std::min(df, period - 1));
+		return true;
+	}
+
+	// The bitmap pixel at the current position, plus offset (0 or 1) pixels
+	inline int index(int offset) const {
+		int x = (f >> kFixedShift) + offset;
+		if (mode == MyShaderFromBitmap::kClamp)
+			return std::max(0, std::min(x, size - 1));
+
+		if (periodMask)
+			x &= periodMask;
+		else if (x >= periodPixels)
+			x -= periodPixels;
+
+		if (mode == MyShaderFromBitmap::kMirror && x >= size)
+			x = periodPixels - 1 - x;
+		return x;
+	}
+
+	inline void next() {
+		f += df;
+		if (mode == MyShaderFromBitmap::kClamp)
+			return;
+
+		if (periodMask)
+			f &= (periodMask << kFixedShift) | (kFixedOne - 1);
+		else if (f >= period)
+			f -= period;
+	}
+};
+
+MyShaderFromBitmap::MyShaderFromBitmap(const GBitmap& bitmap, const float localMatrix[6], FilterQuality filterQuality,
+		TileMode tileX, TileMode tileY) {
+	this->source = bitmap;
 	this->bitmap = bitmap;
+	this->filterQuality = filterQuality;
+	this->tileX = tileX;
+	this->tileY = tileY;
 	for (int i = 0; i < 6; ++i) {
 		this->localMatrix[i] = localMatrix[i];
 	}
 }
 
+MyShaderFromBitmap::~MyShaderFromBitmap() {
+	MyMipmap::Purge(uniqueID());
+}
+
 bool MyShaderFromBitmap::setContext(const float ctm[6]) {
 	for (int i = 0; i < 6; ++i) {
 		this->ctm[i] = ctm[i];
 	}
+
+	if (source.fWidth <= 0 || source.fHeight <= 0)
+		return false;
+
+	// The bitmap's pixels may have changed since the last draw
+	filteredRows[0].y = filteredRows[1].y = -1;
+	bitmap = source;
+
+	// Device space -> bitmap space is the inverse of CTM * localMatrix
+	float matrix[6];
+	MyMatrix_Concat(ctm, localMatrix, matrix);
+	if (!MyMatrix_Invert(matrix, inverse))
+		return false;
+
+	if (filterQuality == kMipmap) {
+		// How many bitmap pixels one device pixel steps over, in the more shrunk direction
+		float scale = std::max(hypotf(inverse[0], inverse[3]), hypotf(inverse[1], inverse[4]));
+		if (scale > 1) {
+			mipmap = MyMipmap::Find(uniqueID(), source);
+			int level = mipmap->chooseLevel(scale);
+			if (level > 0) {
+				// Sample the smaller level instead, scaling bitmap space to match its size
+				bitmap = mipmap->level(level);
+				float sx = (float) bitmap.fWidth / source.fWidth;
+				float sy = (float) bitmap.fHeight / source.fHeight;
+				for (int i = 0; i < 3; ++i) {
+					inverse[i] *= sx;
+					inverse[i + 3] *= sy;
+				}
+			}
+		}
+	}
 	return true;
 }
 
+bool MyShaderFromBitmap::isRowInvariant() const {
+	// Every sample reads the only row; x must not change down the draw
+	return bitmap.fHeight == 1 && inverse[1] == 0;
+}
+
 void MyShaderFromBitmap::shadeRow(int dst_x, int dst_y, int count, GPixel dst_row[]) {
-	// Apply local matrix to y
-	int y = (dst_y - localMatrix[5]) / localMatrix[4];
-	// y mirrored
-	if (ctm[4] < 0)
-		y = bitmap.fHeight - y + bitmap.fHeight * localMatrix[4] + localMatrix[5];
+	if (count <= 0)
+		return;
+
+	// Sample at the center of each device pixel
+	float u = inverse[0] * (dst_x + 0.5f) + inverse[1] * (dst_y + 0.5f) + inverse[2];
+	float v = inverse[3] * (dst_x + 0.5f) + inverse[4] * (dst_y + 0.5f) + inverse[5];
+	float uEnd = u + inverse[0] * count;
+	float vEnd = v + inverse[3] * count;
+
+	if (tileX != kClamp || tileY != kClamp) {
+		shadeRowTiled(u, v, count, dst_row);
+	} else if (std::max(fabsf(u), fabsf(uEnd)) < kFixedMax && std::max(fabsf(v), fabsf(vEnd)) < kFixedMax) {
+		if (filterQuality != kNearest)
+			shadeRowBilinear(toFixed(u), toFixed(v), toFixed(inverse[0]), toFixed(inverse[3]), count, dst_row);
+		else
+			shadeRowFixed(toFixed(u), toFixed(v), toFixed(inverse[0]), toFixed(inverse[3]), count, dst_row);
+	} else {
+		shadeRowFloat(u, v, count, dst_row);
+	}
+}
+
+// Count the leading steps of f, f + df, ... (up to count) whose pixel index is <= limit
+static int countAtMost(int f, int df, int count, int limit) {
+	int64_t bound = (int64_t) (limit + 1) << kFixedShift;
+	if (f >= bound)
+		return 0;
+	if (df <= 0)
+		return count;
+	return (int) std::min<int64_t>(count, (bound - f + df - 1) / df);
+}
 
-	y = std::max(y, 0);
-	y = std::min(y, bitmap.fHeight - 1);
+// Count the leading steps of f, f + df, ... (up to count) whose pixel index is >= limit
+static int countAtLeast(int f, int df, int count, int limit) {
+	int64_t bound = (int64_t) limit << kFixedShift;
+	if (f < bound)
+		return 0;
+	if (df >= 0)
+		return count;
+	return (int) std::min<int64_t>(count, (f - bound) / -df + 1);
+}
 
-	for (int i = dst_x; i < dst_x + count; ++i) {
-		// Apply local matrix to x
-		int x = (i - localMatrix[2]) / localMatrix[0];
-		// x mirrored
-		if (ctm[0] < 0)
-			x = bitmap.fWidth - x + bitmap.fWidth * localMatrix[4] + localMatrix[5];
+int MyShaderFromBitmap::shadeSpan(int dst_x, int dst_y, int count, GPixel dst_row[], Run runs[kMaxRuns]) {
+	if (count <= 0)
+		return 0;
 
-		x = std::max(x, 0);
-		x = std::min(x, bitmap.fWidth - 1);
+	float u = inverse[0] * (dst_x + 0.5f) + inverse[1] * (dst_y + 0.5f) + inverse[2];
+	float v = inverse[3] * (dst_x + 0.5f) + inverse[4] * (dst_y + 0.5f) + inverse[5];
+	float uEnd = u + inverse[0] * count;
 
+	// Only clamped spans that stay on one bitmap row have constant margins
+	if (tileX != kClamp || tileY != kClamp || inverse[3] != 0
+			|| std::max(fabsf(u), fabsf(uEnd)) >= kFixedMax || fabsf(v) >= kFixedMax)
+		return MyShader::shadeSpan(dst_x, dst_y, count, dst_row, runs);
+
+	const int maxX = bitmap.fWidth - 1;
+	const int maxY = bitmap.fHeight - 1;
+	const bool bilinear = filterQuality != kNearest;
+	int fx = toFixed(u);
+	int fy = toFixed(v);
+	int dfx = toFixed(inverse[0]);
+
+	// The colors of the left and right edge columns on this span's row(s)
+	int sy = fy - (bilinear ? kFixedOne >> 1 : 0);
+	const GPixel* top = bitmap.getAddr(0, std::max(0, std::min(sy >> kFixedShift, maxY)));
+	GPixel leftColor = top[0];
+	GPixel rightColor = top[maxX];
+	if (bilinear) {
+		const GPixel* bottom = bitmap.getAddr(0, std::max(0, std::min((sy >> kFixedShift) + 1, maxY)));
+		unsigned wy = (sy >> 8) & 0xFF;
+		leftColor = lerpPixel(leftColor, bottom[0], wy);
+		rightColor = lerpPixel(rightColor, bottom[maxX], wy);
+	}
+
+	// A sample only reads column 0 once its (first) tap is at or before lastLeft, and only
+	// column maxX once it is at or after maxX
+	int sx = fx - (bilinear ? kFixedOne >> 1 : 0);
+	int lastLeft = bilinear ? -1 : 0;
+	int sxLast = sx + (count - 1) * dfx;
+
+	int headLeft = countAtMost(sx, dfx, count, lastLeft);
+	int headRight = countAtLeast(sx, dfx, count, maxX);
+	int head = std::max(headLeft, headRight);
+	GPixel headColor = headLeft >= headRight ? leftColor : rightColor;
+
+	int tailLeft = countAtMost(sxLast, -dfx, count - head, lastLeft);
+	int tailRight = countAtLeast(sxLast, -dfx, count - head, maxX);
+	int tail = std::max(tailLeft, tailRight);
+	GPixel tailColor = tailLeft >= tailRight ? leftColor : rightColor;
+
+	int middle = count - head - tail;
+	if (middle > 0) {
+		if (bilinear)
+			shadeRowBilinear(fx + head * dfx, fy, dfx, 0, middle, &dst_row[head]);
+		else
+			shadeRowFixed(fx + head * dfx, fy, dfx, 0, middle, &dst_row[head]);
+	}
+	return MakeRuns(count, head, headColor, tail, tailColor, runs);
+}
+
+void MyShaderFromBitmap::shadeRowFixed(int fx, int fy, int dfx, int dfy, int count, GPixel dst_row[]) {
+	const int maxX = bitmap.fWidth - 1;
+	const int maxY = bitmap.fHeight - 1;
+	int i = 0;
+
+	if (dfy == 0) {
+		// Every pixel in the span reads from the same bitmap row
+		const GPixel* src_row = bitmap.getAddr(0, std::max(0, std::min(fy >> kFixedShift, maxY)));
+
+		if (dfx == kFixedOne) {
+			// Unscaled: copy the part of the row that overlaps the bitmap, and pad the rest
+			// with the clamped edge pixels.
+			int x = fx >> kFixedShift;
+			int leftPad = std::min(count, std::max(0, -x));
+			for (; i < leftPad; ++i) {
+				dst_row[i] = src_row[0];
+			}
+
+			int copyCount = std::min(count - i, maxX + 1 - (x + i));
+			if (copyCount > 0) {
+				memcpy(&dst_row[i], &src_row[x + i], copyCount * sizeof(GPixel));
+				i += copyCount;
+			}
+
+			for (; i < count; ++i) {
+				dst_row[i] = src_row[maxX];
+			}
+			return;
+		}
+
+		for (; i < count; ++i) {
+			int x = std::max(0, std::min(fx >> kFixedShift, maxX));
+			dst_row[i] = src_row[x];
+			fx += dfx;
+		}
+		return;
+	}
+
+	const GPixel* src_pixels = bitmap.pixels();
+	const int src_stride = bitmap.rowBytes() >> 2;
+
+#ifdef __AVX2__
+	// Rotated or skewed: step eight pixels at once and gather them from the bitmap
+	if (count >= 8) {
+		const __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+		__m256i vfx = _mm256_add_epi32(_mm256_set1_epi32(fx), _mm256_mullo_epi32(lane, _mm256_set1_epi32(dfx)));
+		__m256i vfy = _mm256_add_epi32(_mm256_set1_epi32(fy), _mm256_mullo_epi32(lane, _mm256_set1_epi32(dfy)));
+		const __m256i stepX = _mm256_set1_epi32(dfx * 8);
+		const __m256i stepY = _mm256_set1_epi32(dfy * 8);
+		const __m256i zero = _mm256_setzero_si256();
+		const __m256i vMaxX = _mm256_set1_epi32(maxX);
+		const __m256i vMaxY = _mm256_set1_epi32(maxY);
+		const __m256i stride = _mm256_set1_epi32(src_stride);
+
+		for (; i + 8 <= count; i += 8) {
+			__m256i x = _mm256_min_epi32(_mm256_max_epi32(_mm256_srai_epi32(vfx, kFixedShift), zero), vMaxX);
+			__m256i y = _mm256_min_epi32(_mm256_max_epi32(_mm256_srai_epi32(vfy, kFixedShift), zero), vMaxY);
+			__m256i index = _mm256_add_epi32(_mm256_mullo_epi32(y, stride), x);
+			__m256i pixels = _mm256_i32gather_epi32((const int*) src_pixels, index, 4);
+			_mm256_storeu_si256((__m256i*) &dst_row[i], pixels);
+
+			vfx = _mm256_add_epi32(vfx, stepX);
+			vfy = _mm256_add_epi32(vfy, stepY);
+		}
+		fx += i * dfx;
+		fy += i * dfy;
+	}
+#endif
+
+	for (; i < count; ++i) {
+		int x = std::max(0, std::min(fx >> kFixedShift, maxX));
+		int y = std::max(0, std::min(fy >> kFixedShift, maxY));
+		dst_row[i] = src_pixels[y * src_stride + x];
+		fx += dfx;
+		fy += dfy;
+	}
+}
+
+void MyShaderFromBitmap::shadeRowFloat(float u, float v, int count, GPixel dst_row[]) {
+	// Coordinates too large for 16.16; only reached for extreme matrices or huge tiled bitmaps,
+	// so keep it simple
+	for (int i = 0; i < count; ++i) {
+		float su = wrapToPeriod(u + inverse[0] * i, bitmap.fWidth, tileX);
+		float sv = wrapToPeriod(v + inverse[3] * i, bitmap.fHeight, tileY);
+		float pinnedU = std::max(-kFixedMax, std::min(floorf(su), kFixedMax));
+		float pinnedV = std::max(-kFixedMax, std::min(floorf(sv), kFixedMax));
+		int x = tileIndex((int) pinnedU, bitmap.fWidth, tileX);
+		int y = tileIndex((int) pinnedV, bitmap.fHeight, tileY);
 		dst_row[i] = bitmap.getAddr(x, y)[0];
 	}
 }
+
+void MyShaderFromBitmap::shadeRowBilinear(int fx, int fy, int dfx, int dfy, int count, GPixel dst_row[]) {
+	const int maxX = bitmap.fWidth - 1;
+	const int maxY = bitmap.fHeight - 1;
+
+	// Pixel centers sit at +0.5, so shift back to find the four pixels around the sample
+	fx -= kFixedOne >> 1;
+	fy -= kFixedOne >> 1;
+
+	if (dfy == 0) {
+		// Every pixel in the span blends between the same two bitmap rows. Filter each of them
+		// horizontally (or reuse them from the previous scanline) and blend the two rows.
+		int y0 = std::max(0, std::min(fy >> kFixedShift, maxY));
+		int y1 = std::max(0, std::min((fy >> kFixedShift) + 1, maxY));
+		unsigned wy = (fy >> 8) & 0xFF;
+
+		const GPixel* top = filterRow(y0, fx, dfx, count, y1);
+		if (wy == 0 || y0 == y1) {
+			memcpy(dst_row, top, count * sizeof(GPixel));
+			return;
+		}
+		const GPixel* bottom = filterRow(y1, fx, dfx, count, y0);
+		lerpRows(top, bottom, wy, count, dst_row);
+		return;
+	}
+
+	int i = 0;
+
+#ifdef __AVX2__
+	// Rotated or skewed: gather the four neighbours of eight samples at once
+	if (count >= 8) {
+		const __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+		__m256i vfx = _mm256_add_epi32(_mm256_set1_epi32(fx), _mm256_mullo_epi32(lane, _mm256_set1_epi32(dfx)));
+		__m256i vfy = _mm256_add_epi32(_mm256_set1_epi32(fy), _mm256_mullo_epi32(lane, _mm256_set1_epi32(dfy)));
+		const __m256i stepX = _mm256_set1_epi32(dfx * 8);
+		const __m256i stepY = _mm256_set1_epi32(dfy * 8);
+		const __m256i zero = _mm256_setzero_si256();
+		const __m256i one = _mm256_set1_epi32(1);
+		const __m256i fraction = _mm256_set1_epi32(0xFF);
+		const __m256i vMaxX = _mm256_set1_epi32(maxX);
+		const __m256i vMaxY = _mm256_set1_epi32(maxY);
+		const __m256i stride = _mm256_set1_epi32(bitmap.rowBytes() >> 2);
+		const int* src_pixels = (const int*) bitmap.pixels();
+
+		for (; i + 8 <= count; i += 8) {
+			__m256i x = _mm256_srai_epi32(vfx, kFixedShift);
+			__m256i y = _mm256_srai_epi32(vfy, kFixedShift);
+			__m256i x0 = _mm256_min_epi32(_mm256_max_epi32(x, zero), vMaxX);
+			__m256i x1 = _mm256_min_epi32(_mm256_max_epi32(_mm256_add_epi32(x, one), zero), vMaxX);
+			__m256i row0 = _mm256_mullo_epi32(_mm256_min_epi32(_mm256_max_epi32(y, zero), vMaxY), stride);
+			__m256i row1 = _mm256_mullo_epi32(_mm256_min_epi32(_mm256_max_epi32(_mm256_add_epi32(y, one), zero), vMaxY), stride);
+			__m256i wx = _mm256_and_si256(_mm256_srli_epi32(vfx, 8), fraction);
+			__m256i wy = _mm256_and_si256(_mm256_srli_epi32(vfy, 8), fraction);
+
+			__m256i top = lerpPixels8(_mm256_i32gather_epi32(src_pixels, _mm256_add_epi32(row0, x0), 4),
+					_mm256_i32gather_epi32(src_pixels, _mm256_add_epi32(row0, x1), 4), wx);
+			__m256i bottom = lerpPixels8(_mm256_i32gather_epi32(src_pixels, _mm256_add_epi32(row1, x0), 4),
+					_mm256_i32gather_epi32(src_pixels, _mm256_add_epi32(row1, x1), 4), wx);
+			_mm256_storeu_si256((__m256i*) &dst_row[i], lerpPixels8(top, bottom, wy));
+
+			vfx = _mm256_add_epi32(vfx, stepX);
+			vfy = _mm256_add_epi32(vfy, stepY);
+		}
+		fx += i * dfx;
+		fy += i * dfy;
+	}
+#endif
+
+	for (; i < count; ++i) {
+		int x0 = std::max(0, std::min(fx >> kFixedShift, maxX));
+		int x1 = std::max(0, std::min((fx >> kFixedShift) + 1, maxX));
+		int y0 = std::max(0, std::min(fy >> kFixedShift, maxY));
+		int y1 = std::max(0, std::min((fy >> kFixedShift) + 1, maxY));
+		unsigned wx = (fx >> 8) & 0xFF;
+		unsigned wy = (fy >> 8) & 0xFF;
+
+		const GPixel* top = bitmap.getAddr(0, y0);
+		const GPixel* bottom = bitmap.getAddr(0, y1);
+		dst_row[i] = lerpPixel(lerpPixel(top[x0], top[x1], wx), lerpPixel(bottom[x0], bottom[x1], wx), wy);
+
+		fx += dfx;
+		fy += dfy;
+	}
+}
+
+const GPixel* MyShaderFromBitmap::filterRow(int y, int fx, int dfx, int count, int keepY) {
+	for (int i = 0; i < 2; ++i) {
+		FilteredRow& row = filteredRows[i];
+		if (row.y == y && row.fx == fx && row.dfx == dfx && row.count == count)
+			return row.pixels.data();
+	}
+
+	// Replace the row that the caller doesn't also need for this span
+	FilteredRow& row = filteredRows[0].y == keepY ? filteredRows[1] : filteredRows[0];
+	row.y = y;
+	row.fx = fx;
+	row.dfx = dfx;
+	row.count = count;
+	row.pixels.resize(count);
+
+	const int maxX = bitmap.fWidth - 1;
+	const GPixel* src_row = bitmap.getAddr(0, y);
+	for (int i = 0; i < count; ++i) {
+		int x0 = std::max(0, std::min(fx >> kFixedShift, maxX));
+		int x1 = std::max(0, std::min((fx >> kFixedShift) + 1, maxX));
+		row.pixels[i] = lerpPixel(src_row[x0], src_row[x1], (fx >> 8) & 0xFF);
+		fx += dfx;
+	}
+	return row.pixels.data();
+}
+
+void MyShaderFromBitmap::shadeRowTiled(float u, float v, int count, GPixel dst_row[]) {
+	// Bilinear blends the pixels around the sample, whose centers sit at +0.5
+	float offset = filterQuality == kNearest ? 0 : 0.5f;
+
+	AxisStepper sx, sy;
+	if (!sx.init(tileX, bitmap.fWidth, u - offset, inverse[0], count)
+			|| !sy.init(tileY, bitmap.fHeight, v - offset, inverse[3], count)) {
+		shadeRowFloat(u, v, count, dst_row);
+		return;
+	}
+
+	const GPixel* src_pixels = bitmap.pixels();
+	const int src_stride = bitmap.rowBytes() >> 2;
+
+	if (filterQuality == kNearest) {
+		if (sy.df == 0 && sx.df == kFixedOne && tileX == kRepeat) {
+			// Unscaled repeat: copy runs of the source row, wrapping back to its start
+			const GPixel* src_row = &src_pixels[sy.index(0) * src_stride];
+			int x = sx.index(0);
+			for (int i = 0; i < count;) {
+				int run = std::min(count - i, bitmap.fWidth - x);
+				memcpy(&dst_row[i], &src_row[x], run * sizeof(GPixel));
+				i += run;
+				x = 0;
+			}
+			return;
+		}
+
+		for (int i = 0; i < count; ++i) {
+			dst_row[i] = src_pixels[sy.index(0) * src_stride + sx.index(0)];
+			sx.next();
+			sy.next();
+		}
+		return;
+	}
+
+	for (int i = 0; i < count; ++i) {
+		const GPixel* top = &src_pixels[sy.index(0) * src_stride];
+		const GPixel* bottom = &src_pixels[sy.index(1) * src_stride];
+		int x0 = sx.index(0);
+		int x1 = sx.index(1);
+		unsigned wx = (sx.f >> 8) & 0xFF;
+		unsigned wy = (sy.f >> 8) & 0xFF;
+		dst_row[i] = lerpPixel(lerpPixel(top[x0], top[x1], wx), lerpPixel(bottom[x0], bottom[x1], wx), wy);
+
+		sx.next();
+		sy.next();
+	}
+}
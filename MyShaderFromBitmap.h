@@ -2,13 +2,46 @@
  *  Copyright 2015 Wesley Lo
  */
 
+#ifndef MyShaderFromBitmap_DEFINED
+#define MyShaderFromBitmap_DEFINED
+
 #include <algorithm>
-#include "GShader.h"
+#include <vector>
 #include "GBitmap.h"
+#include "MyMipmap.h"
+#include "MyShader.h"
 
-class MyShaderFromBitmap: public GShader {
+class MyShaderFromBitmap: public MyShader {
 public:
-	MyShaderFromBitmap(const GBitmap&, const float localMatrix[6]);
+	/**
+	 *  How the bitmap is sampled. kNearest picks the single closest pixel, kBilinear blends the
+	 *  four pixels around the sample point. kMipmap also blends four pixels, but when the bitmap
+	 *  is drawn smaller than its size it samples from a cached, pre-shrunk copy (see MyMipmap)
+	 *  picked from the CTM's scale.
+	 */
+	enum FilterQuality {
+		kNearest,
+		kBilinear,
+		kMipmap
+	};
+
+	/**
+	 *  What to draw outside the bitmap's bounds. kClamp repeats the edge pixels, kRepeat tiles
+	 *  the bitmap, and kMirror tiles it while flipping every other copy.
+	 */
+	enum TileMode {
+		kClamp,
+		kRepeat,
+		kMirror
+	};
+
+	MyShaderFromBitmap(const GBitmap&, const float localMatrix[6], FilterQuality = kNearest,
+			TileMode tileX = kClamp, TileMode tileY = kClamp);
+
+	/**
+	 *  Drops the mipmap levels cached for this shader.
+	 */
+	~MyShaderFromBitmap();
 
 	/**
 	 *  Called before each use, this tells the shader the CTM for the current drawing.
@@ -25,8 +58,47 @@ public:
 	 */
 	void shadeRow(int x, int y, int count, GPixel row[]);
 
+	/**
+	 *  With clamped tiling, pixels that sample beyond the left or right edge of the bitmap all
+	 *  read the same edge column; those margins are reported as constant runs.
+	 */
+	int shadeSpan(int x, int y, int count, GPixel row[], Run runs[kMaxRuns]);
+
+	/**
+	 *  True for a one pixel tall bitmap (or mipmap level) whose x doesn't depend on device y.
+	 */
+	bool isRowInvariant() const;
+
 protected:
-	GBitmap bitmap;
+	GBitmap source; // The bitmap the shader was created with
+	GBitmap bitmap; // The bitmap being sampled: source, or one of its mipmap levels
+	std::shared_ptr<const MyMipmap> mipmap;
 	float localMatrix[6];
 	float ctm[6] = { 1, 0, 0, 0, 1, 0 }; // Initialize ctm to identity matrix
+	float inverse[6] = { 1, 0, 0, 0, 1, 0 }; // Maps device space back to bitmap space (CTM * localMatrix)^-1
+	FilterQuality filterQuality;
+	TileMode tileX, tileY;
+
+	// Horizontally filtered bitmap rows from the last spans, so the next scanline can reuse
+	// one (or both) of the two rows it blends between.
+	struct FilteredRow {
+		int y = -1;
+		int fx = 0;
+		int dfx = 0;
+		int count = 0;
+		std::vector<GPixel> pixels;
+	};
+	FilteredRow filteredRows[2];
+
+	void shadeRowFixed(int fx, int fy, int dfx, int dfy, int count, GPixel row[]);
+
+	void shadeRowFloat(float u, float v, int count, GPixel row[]);
+
+	void shadeRowBilinear(int fx, int fy, int dfx, int dfy, int count, GPixel row[]);
+
+	void shadeRowTiled(float u, float v, int count, GPixel row[]);
+
+	const GPixel* filterRow(int y, int fx, int dfx, int count, int keepY);
 };
+
+#endif
@@ -2,15 +2,43 @@
  *  Copyright 2015 Wesley Lo
  */
 
+#include <algorithm>
+#include <cmath>
 #include "MyShaderFromLinearGradient.h"
+#include "MyLowp.h"
+#include "MyMatrix.h"
+
+// Premultiply a color in [0, 1]; the canvas does the blending
+static inline GPixel premultiply(float a, float r, float g, float b) {
+	float a_255 = a * 255.9999f;
+	return GPixel_PackARGB(a_255, r * a_255, g * a_255, b * a_255);
+}
+
+// lowp t is 8.24 fixed point; |t| must stay below this to step it without overflowing
+static const int kLowpTShift = 24;
+static const float kLowpTMax = 64;
+
+// Count the leading steps of t, t + dt, ... (up to count) that are <= 0
+static int countNotAbove0(float t, float dt, int count) {
+	if (t > 0)
+		return 0;
+	if (dt <= 0)
+		return count;
+	return (int) std::min((float) count, floorf(-t / dt) + 1);
+}
 
 MyShaderFromLinearGradient::MyShaderFromLinearGradient(const GPoint pts[2], const GColor colors[2]) {
 	this->pts[0].fX = pts[0].fX;
 	this->pts[0].fY = pts[0].fY;
 	this->pts[1].fX = pts[1].fX;
 	this->pts[1].fY = pts[1].fY;
-	this->colors[0] = GColor::MakeARGB(colors[0].fA, colors[0].fR, colors[0].fG, colors[0].fB);
-	this->colors[1] = GColor::MakeARGB(colors[1].fA, colors[1].fR, colors[1].fG, colors[1].fB);
+	this->colors[0] = colors[0].pinToUnit();
+	this->colors[1] = colors[1].pinToUnit();
+
+	for (int i = 0; i < 2; ++i) {
+		premulColors[i] = premultiply(this->colors[i].fA, this->colors[i].fR, this->colors[i].fG, this->colors[i].fB);
+	}
+	lowp = this->colors[0].fA == this->colors[1].fA;
 }
 
 bool MyShaderFromLinearGradient::setContext(const float ctm[6]) {
@@ -18,72 +46,139 @@ bool MyShaderFromLinearGradient::setContext(const float ctm[6]) {
 		this->ctm[i] = ctm[i];
 	}
 
-	ptsTransformed[0] = GPoint::Make(pts[0].fX, pts[0].fY);
-	ptsTransformed[1] = GPoint::Make(pts[1].fX, pts[1].fY);
-
-	colorsTransformed[0] = GColor::MakeARGB(colors[0].fA, colors[0].fR, colors[0].fG, colors[0].fB);
-	colorsTransformed[1] = GColor::MakeARGB(colors[1].fA, colors[1].fR, colors[1].fG, colors[1].fB);
-
-	bool rotated = ctm[1] != 0.0 || ctm[3] != 0.0;
-	if (!rotated) {
-		float x0Transformed = ctm[0] * pts[0].fX + ctm[1] * pts[0].fY + ctm[2];
-		float y0Transformed = ctm[3] * pts[0].fX + ctm[4] * pts[0].fY + ctm[5];
-		float x1Transformed = ctm[0] * pts[1].fX + ctm[1] * pts[1].fY + ctm[2];
-		float y1Transformed = ctm[3] * pts[1].fX + ctm[4] * pts[1].fY + ctm[5];
-		if (x0Transformed < x1Transformed) {
-			ptsTransformed[0] = GPoint::Make(x0Transformed, y0Transformed);
-			ptsTransformed[1] = GPoint::Make(x1Transformed, y1Transformed);
-		} else {
-			ptsTransformed[0] = GPoint::Make(x1Transformed, y1Transformed);
-			ptsTransformed[1] = GPoint::Make(x0Transformed, y0Transformed);
-
-			colorsTransformed[0] = GColor::MakeARGB(colors[1].fA, colors[1].fR, colors[1].fG, colors[1].fB);
-			colorsTransformed[1] = GColor::MakeARGB(colors[0].fA, colors[0].fR, colors[0].fG, colors[0].fB);
-		}
+	float inverse[6];
+	if (!MyMatrix_Invert(ctm, inverse))
+		return false;
+
+	// Project the (inverse mapped) device point onto the gradient vector:
+	// t = ((u - x0) * dx + (v - y0) * dy) / |d|^2
+	float dx = pts[1].fX - pts[0].fX;
+	float dy = pts[1].fY - pts[0].fY;
+	float lengthSq = dx * dx + dy * dy;
+	if (lengthSq == 0) {
+		// Degenerate gradient, draw it as the end color
+		dtdx = dtdy = 0;
+		tOrigin = 1;
+		return true;
 	}
+
+	dtdx = (inverse[0] * dx + inverse[3] * dy) / lengthSq;
+	dtdy = (inverse[1] * dx + inverse[4] * dy) / lengthSq;
+	tOrigin = ((inverse[2] - pts[0].fX) * dx + (inverse[5] - pts[0].fY) * dy) / lengthSq;
 	return true;
 }
 
+bool MyShaderFromLinearGradient::isRowInvariant() const {
+	return dtdy == 0;
+}
+
 void MyShaderFromLinearGradient::shadeRow(int dst_x, int dst_y, int count, GPixel dst_row[]) {
-	float src_a0_01 = colorsTransformed[0].fA < 0 ? 0 : colorsTransformed[0].fA;
-	float src_r0 = colorsTransformed[0].fR < 0 ? 0 : colorsTransformed[0].fR * 255;
-	float src_g0 = colorsTransformed[0].fG < 0 ? 0 : colorsTransformed[0].fG * 255;
-	float src_b0 = colorsTransformed[0].fB < 0 ? 0 : colorsTransformed[0].fB * 255;
-
-	float src_a1_01 = colorsTransformed[1].fA < 0 ? 0 : colorsTransformed[1].fA;
-	float src_r1 = colorsTransformed[1].fR < 0 ? 0 : colorsTransformed[1].fR * 255;
-	float src_g1 = colorsTransformed[1].fG < 0 ? 0 : colorsTransformed[1].fG * 255;
-	float src_b1 = colorsTransformed[1].fB < 0 ? 0 : colorsTransformed[1].fB * 255;
-
-	float delta_a_01 = (src_a1_01 - src_a0_01) / (std::min((int) ptsTransformed[1].fX, dst_x + count) - std::max((int) ptsTransformed[0].fX, dst_x) + 1);
-	float delta_r = (src_r1 - src_r0) / (std::min((int) ptsTransformed[1].fX, dst_x + count) - std::max((int) ptsTransformed[0].fX, dst_x) + 1);
-	float delta_g = (src_g1 - src_g0) / (std::min((int) ptsTransformed[1].fX, dst_x + count) - std::max((int) ptsTransformed[0].fX, dst_x) + 1);
-	float delta_b = (src_b1 - src_b0) / (std::min((int) ptsTransformed[1].fX, dst_x + count) - std::max((int) ptsTransformed[0].fX, dst_x) + 1);
-
-	for (int i = dst_x; i < dst_x + count; ++i) {
-		float dst_a_01 = GPixel_GetA(dst_row[i]) / 255;
-		float dst_r = GPixel_GetR(dst_row[i]);
-		float dst_g = GPixel_GetG(dst_row[i]);
-		float dst_b = GPixel_GetB(dst_row[i]);
-
-		float blend_a_01 = src_a0_01 + (dst_a_01 * (1 - src_a0_01));
-		int blend_a = blend_a_01 * 255;
-		int blend_r = blend_a == 0 ? 0 : ((src_r0 * src_a0_01) + ((dst_r * dst_a_01) * (1 - src_a0_01))) / blend_a_01;
-		int blend_g = blend_a == 0 ? 0 : ((src_g0 * src_a0_01) + ((dst_g * dst_a_01) * (1 - src_a0_01))) / blend_a_01;
-		int blend_b = blend_a == 0 ? 0 : ((src_b0 * src_a0_01) + ((dst_b * dst_a_01) * (1 - src_a0_01))) / blend_a_01;
-
-		dst_row[i] = GPixel_PackARGB(blend_a, blend_r, blend_g, blend_b);
-
-		if (i > ptsTransformed[1].fX) {
-			src_a0_01 = colorsTransformed[1].fA < 0 ? 0 : colorsTransformed[1].fA;
-			src_r0 = colorsTransformed[1].fR < 0 ? 0 : colorsTransformed[1].fR * 255;
-			src_g0 = colorsTransformed[1].fG < 0 ? 0 : colorsTransformed[1].fG * 255;
-			src_b0 = colorsTransformed[1].fB < 0 ? 0 : colorsTransformed[1].fB * 255;
-		} else if (i > ptsTransformed[0].fX) {
-			src_a0_01 += delta_a_01;
-			src_r0 += delta_r;
-			src_g0 += delta_g;
-			src_b0 += delta_b;
+	float delta_a = colors[1].fA - colors[0].fA;
+	float delta_r = colors[1].fR - colors[0].fR;
+	float delta_g = colors[1].fG - colors[0].fG;
+	float delta_b = colors[1].fB - colors[0].fB;
+
+	// Sample at the center of each device pixel
+	float t = dtdx * (dst_x + 0.5f) + dtdy * (dst_y + 0.5f) + tOrigin;
+
+	if (lowp && std::max(fabsf(t), fabsf(t + dtdx * count)) < kLowpTMax) {
+		shadeRowLowp(t, count, dst_row);
+		return;
+	}
+
+	for (int i = 0; i < count; ++i) {
+		float clamped = std::max(0.0f, std::min(t, 1.0f));
+		float a = colors[0].fA + delta_a * clamped;
+		float r = colors[0].fR + delta_r * clamped;
+		float g = colors[0].fG + delta_g * clamped;
+		float b = colors[0].fB + delta_b * clamped;
+
+		dst_row[i] = premultiply(a, r, g, b);
+
+		t += dtdx;
+	}
+}
+
+int MyShaderFromLinearGradient::shadeSpan(int dst_x, int dst_y, int count, GPixel dst_row[], Run runs[kMaxRuns]) {
+	if (count <= 0)
+		return 0;
+
+	float t = dtdx * (dst_x + 0.5f) + dtdy * (dst_y + 0.5f) + tOrigin;
+	float tLast = t + dtdx * (count - 1);
+	const GPixel startColor = premulColors[0];
+	const GPixel endColor = premulColors[1];
+
+	// Pinned to the start color where t <= 0, and to the end color where t >= 1 (1 - t <= 0)
+	int headStart = countNotAbove0(t, dtdx, count);
+	int headEnd = countNotAbove0(1 - t, -dtdx, count);
+	int head = std::max(headStart, headEnd);
+	GPixel headColor = headStart >= headEnd ? startColor : endColor;
+
+	int tailStart = countNotAbove0(tLast, -dtdx, count - head);
+	int tailEnd = countNotAbove0(1 - tLast, dtdx, count - head);
+	int tail = std::max(tailStart, tailEnd);
+	GPixel tailColor = tailStart >= tailEnd ? startColor : endColor;
+
+	int middle = count - head - tail;
+	if (middle > 0) {
+		shadeRow(dst_x + head, dst_y, middle, &dst_row[head]);
+	}
+	return MakeRuns(count, head, headColor, tail, tailColor, runs);
+}
+
+void MyShaderFromLinearGradient::shadeRowLowp(float t, int count, GPixel dst_row[]) {
+	// Pixel i gets weight w = round(t_i * 256), pinned to [0, 256], and each premultiplied
+	// channel is c0 + (c1 - c0) * w / 256. t_i is computed from t rather than accumulated.
+	const int ft = (int) lroundf(t * (1 << kLowpTShift));
+	const int dft = (int) lroundf(dtdx * (1 << kLowpTShift));
+	const int wShift = kLowpTShift - 8;
+	const int wRound = 1 << (wShift - 1);
+	const GPixel c0 = premulColors[0];
+	const GPixel c1 = premulColors[1];
+	int i = 0;
+
+#ifdef __AVX2__
+	if (count >= 16) {
+		const __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+		__m256i vt = _mm256_add_epi32(_mm256_set1_epi32(ft + wRound), _mm256_mullo_epi32(lane, _mm256_set1_epi32(dft)));
+		const __m256i half = _mm256_set1_epi32(dft * 8);
+		const __m256i step = _mm256_set1_epi32(dft * 16);
+		const __m256i zero = _mm256_setzero_si256();
+		const __m256i one = _mm256_set1_epi16(256);
+
+		MyLowp16 from, to;
+		from.a = _mm256_set1_epi16(GPixel_GetA(c0));
+		from.r = _mm256_set1_epi16(GPixel_GetR(c0));
+		from.g = _mm256_set1_epi16(GPixel_GetG(c0));
+		from.b = _mm256_set1_epi16(GPixel_GetB(c0));
+		to.a = _mm256_set1_epi16(GPixel_GetA(c1));
+		to.r = _mm256_set1_epi16(GPixel_GetR(c1));
+		to.g = _mm256_set1_epi16(GPixel_GetG(c1));
+		to.b = _mm256_set1_epi16(GPixel_GetB(c1));
+
+		for (; i + 16 <= count; i += 16) {
+			// Weights for pixels i..i+7 and i+8..i+15, packed the way MyLowp_Load16 lays out lanes
+			__m256i wLo = _mm256_srai_epi32(vt, wShift);
+			__m256i wHi = _mm256_srai_epi32(_mm256_add_epi32(vt, half), wShift);
+			__m256i w = _mm256_min_epi16(_mm256_max_epi16(_mm256_packs_epi32(wLo, wHi), zero), one);
+
+			MyLowp16 p;
+			p.a = MyLowp_Lerp(from.a, to.a, w);
+			p.r = MyLowp_Lerp(from.r, to.r, w);
+			p.g = MyLowp_Lerp(from.g, to.g, w);
+			p.b = MyLowp_Lerp(from.b, to.b, w);
+			MyLowp_Store16(&dst_row[i], p);
+
+			vt = _mm256_add_epi32(vt, step);
 		}
 	}
+#endif
+
+	for (; i < count; ++i) {
+		int w = std::max(0, std::min((ft + i * dft + wRound) >> wShift, 256));
+		dst_row[i] = GPixel_PackARGB((GPixel_GetA(c0) * (256 - w) + GPixel_GetA(c1) * w) >> 8,
+				(GPixel_GetR(c0) * (256 - w) + GPixel_GetR(c1) * w) >> 8,
+				(GPixel_GetG(c0) * (256 - w) + GPixel_GetG(c1) * w) >> 8,
+				(GPixel_GetB(c0) * (256 - w) + GPixel_GetB(c1) * w) >> 8);
+	}
 }
@@ -2,11 +2,11 @@
  *  Copyright 2015 Wesley Lo
  */
 
-#include "GShader.h"
 #include "GPoint.h"
 #include "GColor.h"
+#include "MyShader.h"
 
-class MyShaderFromLinearGradient: public GShader {
+class MyShaderFromLinearGradient: public MyShader {
 public:
 	MyShaderFromLinearGradient(const GPoint pts[2], const GColor colors[2]);
 
@@ -25,8 +25,29 @@ public:
 	 */
 	void shadeRow(int x, int y, int count, GPixel row[]);
 
+	/**
+	 *  Pixels before the start point or past the end point are pinned to the end colors; those
+	 *  parts of the span are reported as constant runs.
+	 */
+	int shadeSpan(int x, int y, int count, GPixel row[], Run runs[kMaxRuns]);
+
+	/**
+	 *  True when the gradient runs horizontally in device space.
+	 */
+	bool isRowInvariant() const;
+
 protected:
-	GPoint pts[2], ptsTransformed[2];
-	GColor colors[2], colorsTransformed[2];
+	GPoint pts[2];
+	GColor colors[2];
 	float ctm[6] = { 1, 0, 0, 0, 1, 0 }; // Initialize ctm to identity matrix
+
+	// t (0 at pts[0], 1 at pts[1]) as an affine function of device x and y
+	float dtdx = 0, dtdy = 0, tOrigin = 0;
+
+	// The end colors, premultiplied. When both have the same alpha, interpolating these gives
+	// the same colors as interpolating and then premultiplying, so the lowp path can be used.
+	GPixel premulColors[2];
+	bool lowp;
+
+	void shadeRowLowp(float t, int count, GPixel row[]);
 };
@@ -0,0 +1,171 @@
+/*
+ *  Copyright 2015 Wesley Lo
+ */
+
+#include <algorithm>
+#include <cmath>
+#include "MyShaderFromNoise.h"
+#include "MyMatrix.h"
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+// Wrap a lattice cell into [0, size) in float, since floor() of a far away point is out of the
+// range of int. A cell that isn't finite wraps to NaN, which goes to 0 like the AVX2 loop's
+// conversion does. size is a power of two, so the wrap is exact.
+static inline int wrapCell(float cell, int size) {
+	float wrapped = cell - size * floorf(cell * (1.0f / size));
+	return wrapped >= 0 && wrapped < size ? (int) wrapped : 0;
+}
+
+MyShaderFromNoise::MyShaderFromNoise(const GColor colors[2], float frequency, int octaves, unsigned seed) {
+	this->frequency = frequency;
+	this->octaves = std::max(1, std::min(octaves, (int) kMaxOctaves));
+
+	// Shuffle the lattice with a small LCG so a seed always makes the same texture
+	for (int i = 0; i < kLatticeSize; ++i) {
+		perm[i] = i;
+	}
+	uint32_t state = seed;
+	for (int i = kLatticeSize - 1; i > 0; --i) {
+		state = state * 1664525u + 1013904223u;
+		std::swap(perm[i], perm[(state >> 8) % (i + 1)]);
+	}
+	for (int i = 0; i < kLatticeSize; ++i) {
+		perm[kLatticeSize + i] = perm[i];
+	}
+
+	GColor c0 = colors[0].pinToUnit();
+	GColor c1 = colors[1].pinToUnit();
+	for (int i = 0; i < kLutSize; ++i) {
+		float t = i / (float) (kLutSize - 1);
+		float a = (c0.fA + (c1.fA - c0.fA) * t) * 255.9999f;
+		lut[i] = GPixel_PackARGB(a, (c0.fR + (c1.fR - c0.fR) * t) * a, (c0.fG + (c1.fG - c0.fG) * t) * a,
+				(c0.fB + (c1.fB - c0.fB) * t) * a);
+	}
+}
+
+bool MyShaderFromNoise::setContext(const float ctm[6]) {
+	return MyMatrix_Invert(ctm, inverse);
+}
+
+/*
+ *  Noise at local point (x, y), in [0, 1]. The AVX2 loop in shadeRow() does the same operations
+ *  in the same order, so output doesn't depend on whether AVX2 is available.
+ */
+float MyShaderFromNoise::noiseAt(float x, float y) const {
+	float sum = 0;
+	float weight = 1;
+	float totalWeight = 0;
+	float scale = frequency;
+	for (int o = 0; o < octaves; ++o) {
+		float fx = x * scale;
+		float fy = y * scale;
+		float cellX = floorf(fx);
+		float cellY = floorf(fy);
+		float tx = fx - cellX;
+		float ty = fy - cellY;
+		int ix = wrapCell(cellX, kLatticeSize);
+		int iy = wrapCell(cellY, kLatticeSize);
+
+		// The lattice values at the cell's corners, in [0, 255]
+		float v00 = perm[perm[ix] + iy];
+		float v10 = perm[perm[ix + 1] + iy];
+		float v01 = perm[perm[ix] + iy + 1];
+		float v11 = perm[perm[ix + 1] + iy + 1];
+
+		// Smoothstep so the noise has no creases at cell edges
+		tx = tx * tx * (3 - 2 * tx);
+		ty = ty * ty * (3 - 2 * ty);
+		float top = v00 + (v10 - v00) * tx;
+		float bottom = v01 + (v11 - v01) * tx;
+		sum = sum + (top + (bottom - top) * ty) * weight;
+
+		totalWeight = totalWeight + weight;
+		weight = weight * 0.5f;
+		scale = scale * 2;
+	}
+	return sum / (totalWeight * (kLatticeSize - 1));
+}
+
+void MyShaderFromNoise::shadeRow(int dst_x, int dst_y, int count, GPixel dst_row[]) {
+	// Map the center of the first pixel back into local space
+	const float du = inverse[0];
+	const float dv = inverse[3];
+	const float u0 = inverse[0] * (dst_x + 0.5f) + inverse[1] * (dst_y + 0.5f) + inverse[2];
+	const float v0 = inverse[3] * (dst_x + 0.5f) + inverse[4] * (dst_y + 0.5f) + inverse[5];
+	int i = 0;
+
+#ifdef __AVX2__
+	const __m256 lane = _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7);
+	const __m256i mask = _mm256_set1_epi32(kLatticeSize - 1);
+	const __m256 latticeSize = _mm256_set1_ps(kLatticeSize);
+	const __m256 latticeScale = _mm256_set1_ps(1.0f / kLatticeSize);
+	const __m256i oneInt = _mm256_set1_epi32(1);
+	const __m256 two = _mm256_set1_ps(2);
+	const __m256 three = _mm256_set1_ps(3);
+	const __m256 lutScale = _mm256_set1_ps(kLutSize - 1);
+	const __m256 half = _mm256_set1_ps(0.5f);
+
+	// The weights don't depend on the pixel, so the normalization is a scalar
+	float totalWeight = 0;
+	float octaveWeight = 1;
+	for (int o = 0; o < octaves; ++o) {
+		totalWeight = totalWeight + octaveWeight;
+		octaveWeight = octaveWeight * 0.5f;
+	}
+	const __m256 normalize = _mm256_set1_ps(totalWeight * (kLatticeSize - 1));
+
+	for (; i + 8 <= count; i += 8) {
+		__m256 index = _mm256_add_ps(_mm256_set1_ps((float) i), lane);
+		__m256 x = _mm256_add_ps(_mm256_set1_ps(u0), _mm256_mul_ps(index, _mm256_set1_ps(du)));
+		__m256 y = _mm256_add_ps(_mm256_set1_ps(v0), _mm256_mul_ps(index, _mm256_set1_ps(dv)));
+
+		__m256 sum = _mm256_setzero_ps();
+		float weight = 1;
+		float scale = frequency;
+		for (int o = 0; o < octaves; ++o) {
+			__m256 fx = _mm256_mul_ps(x, _mm256_set1_ps(scale));
+			__m256 fy = _mm256_mul_ps(y, _mm256_set1_ps(scale));
+			__m256 cellX = _mm256_floor_ps(fx);
+			__m256 cellY = _mm256_floor_ps(fy);
+			__m256 tx = _mm256_sub_ps(fx, cellX);
+			__m256 ty = _mm256_sub_ps(fy, cellY);
+			__m256 wrapX = _mm256_sub_ps(cellX, _mm256_mul_ps(latticeSize,
+					_mm256_floor_ps(_mm256_mul_ps(cellX, latticeScale))));
+			__m256 wrapY = _mm256_sub_ps(cellY, _mm256_mul_ps(latticeSize,
+					_mm256_floor_ps(_mm256_mul_ps(cellY, latticeScale))));
+			// The mask only takes a NaN's INT_MIN to 0
+			__m256i ix = _mm256_and_si256(_mm256_cvttps_epi32(wrapX), mask);
+			__m256i iy = _mm256_and_si256(_mm256_cvttps_epi32(wrapY), mask);
+
+			__m256i px0 = _mm256_add_epi32(_mm256_i32gather_epi32(perm, ix, 4), iy);
+			__m256i px1 = _mm256_add_epi32(_mm256_i32gather_epi32(perm, _mm256_add_epi32(ix, oneInt), 4), iy);
+			__m256 v00 = _mm256_cvtepi32_ps(_mm256_i32gather_epi32(perm, px0, 4));
+			__m256 v10 = _mm256_cvtepi32_ps(_mm256_i32gather_epi32(perm, px1, 4));
+			__m256 v01 = _mm256_cvtepi32_ps(_mm256_i32gather_epi32(perm, _mm256_add_epi32(px0, oneInt), 4));
+			__m256 v11 = _mm256_cvtepi32_ps(_mm256_i32gather_epi32(perm, _mm256_add_epi32(px1, oneInt), 4));
+
+			tx = _mm256_mul_ps(_mm256_mul_ps(tx, tx), _mm256_sub_ps(three, _mm256_mul_ps(two, tx)));
+			ty = _mm256_mul_ps(_mm256_mul_ps(ty, ty), _mm256_sub_ps(three, _mm256_mul_ps(two, ty)));
+			__m256 top = _mm256_add_ps(v00, _mm256_mul_ps(_mm256_sub_ps(v10, v00), tx));
+			__m256 bottom = _mm256_add_ps(v01, _mm256_mul_ps(_mm256_sub_ps(v11, v01), tx));
+			__m256 value = _mm256_add_ps(top, _mm256_mul_ps(_mm256_sub_ps(bottom, top), ty));
+			sum = _mm256_add_ps(sum, _mm256_mul_ps(value, _mm256_set1_ps(weight)));
+
+			weight = weight * 0.5f;
+			scale = scale * 2;
+		}
+
+		__m256 n = _mm256_div_ps(sum, normalize);
+		__m256i k = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(n, lutScale), half));
+		_mm256_storeu_si256((__m256i*) &dst_row[i], _mm256_i32gather_epi32((const int*) lut, k, 4));
+	}
+#endif
+
+	for (; i < count; ++i) {
+		float n = noiseAt(u0 + (float) i * du, v0 + (float) i * dv);
+		dst_row[i] = lut[(int) (n * (kLutSize - 1) + 0.5f)];
+	}
+}
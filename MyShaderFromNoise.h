@@ -0,0 +1,57 @@
+/*
+ *  Copyright 2015 Wesley Lo
+ */
+
+#include "GColor.h"
+#include "MyShader.h"
+
+/**
+ *  Procedural value noise, for paper and grain textures without a bitmap. Octaves of smoothly
+ *  interpolated random lattice values are summed (each at twice the frequency and half the
+ *  weight of the last), and the sum in [0, 1] picks a color between colors[0] and colors[1].
+ *  The same seed always gives the same texture.
+ */
+class MyShaderFromNoise: public MyShader {
+public:
+	/**
+	 *  frequency is in lattice cells per unit of local space; octaves is pinned to [1, kMaxOctaves].
+	 */
+	MyShaderFromNoise(const GColor colors[2], float frequency, int octaves, unsigned seed);
+
+	enum {
+		kMaxOctaves = 8
+	};
+
+	/**
+	 *  Called before each use, this tells the shader the CTM for the current drawing.
+	 *  This returns true if the shader can handle the CTM, and therefore it is valid to call
+	 *  shadeRow(). If it cannot handle the CTM, this will return false, and shadeRow()
+	 *  should not be called.
+	 */
+	bool setContext(const float ctm[6]);
+
+	/**
+	 *  Given a row of pixels in device space [x, y] ... [x + count - 1, y], return the
+	 *  corresponding src pixels in row[0...count - 1]. The caller must ensure that row[]
+	 *  can hold at least [count] entries.
+	 */
+	void shadeRow(int x, int y, int count, GPixel row[]);
+
+protected:
+	enum {
+		kLatticeSize = 256,
+		kLutSize = 256
+	};
+
+	float frequency;
+	int octaves;
+	float inverse[6] = { 1, 0, 0, 0, 1, 0 }; // device to local space
+
+	// A seeded permutation of [0, 256), repeated so perm[perm[x] + y] needs no wrap
+	int perm[kLatticeSize * 2];
+
+	// The premultiplied colors for noise 0, 1 / 255, ... 1
+	GPixel lut[kLutSize];
+
+	float noiseAt(float x, float y) const;
+};
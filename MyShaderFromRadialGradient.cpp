@@ -47,6 +47,6 @@ void MyShaderFromRadialGradient::shadeRow(int dst_x, int dst_y, int count, GPixe
 		float r = src_r0 + range_r * ratio;
 		float g = src_g0 + range_g * ratio;
 		float b = src_b0 + range_b * ratio;
-		dst_row[i] = GPixel_PackARGB(src_a0, r, g, b);
+		dst_row[i - dst_x] = GPixel_PackARGB(src_a0, r, g, b);
 	}
 }
@@ -2,11 +2,11 @@
  *  Copyright 2015 Wesley Lo
  */
 
-#include "GShader.h"
 #include "GPoint.h"
 #include "GColor.h"
+#include "MyShader.h"
 
-class MyShaderFromRadialGradient: public GShader {
+class MyShaderFromRadialGradient: public MyShader {
 public:
 	MyShaderFromRadialGradient(const GPoint& center, float radius, const GColor colors[2]);
 
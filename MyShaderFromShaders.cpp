@@ -0,0 +1,77 @@
+/*
+ *  Copyright 2015 Wesley Lo
+ */
+
+#include <algorithm>
+#include "MyShaderFromShaders.h"
+
+MyShaderFromShaders::MyShaderFromShaders(GShader* a, GShader* b, MyBlendMode mode) {
+	shaders[0] = a;
+	shaders[1] = b;
+	for (int i = 0; i < 2; ++i) {
+		myShaders[i] = dynamic_cast<MyShader*>(shaders[i]);
+	}
+	this->mode = mode;
+	blendRow = MyBlend_RowProc(mode);
+}
+
+bool MyShaderFromShaders::setContext(const float ctm[6]) {
+	return shaders[0]->setContext(ctm) && shaders[1]->setContext(ctm);
+}
+
+void MyShaderFromShaders::shadeRow(int dst_x, int dst_y, int count, GPixel dst_row[]) {
+	scratch.resize(std::max((size_t) count, scratch.size()));
+	GPixel* src_row = scratch.data();
+	shaders[0]->shadeRow(dst_x, dst_y, count, dst_row);
+	shaders[1]->shadeRow(dst_x, dst_y, count, src_row);
+	blendRow(dst_row, src_row, count);
+}
+
+int MyShaderFromShaders::shadeSpan(int dst_x, int dst_y, int count, GPixel dst_row[], Run runs[kMaxRuns]) {
+	if (count <= 0)
+		return 0;
+
+	scratch.resize(std::max((size_t) count, scratch.size()));
+	GPixel* src_row = scratch.data();
+	GPixel dstColor, srcColor;
+	bool dstConstant = shadeInto(0, dst_x, dst_y, count, dst_row, &dstColor);
+	bool srcConstant = shadeInto(1, dst_x, dst_y, count, src_row, &srcColor);
+
+	if (dstConstant && srcConstant) {
+		runs[0] = { count, true, MyBlend_Pixel(mode, srcColor, dstColor) };
+		return 1;
+	}
+
+	if (dstConstant)
+		std::fill_n(dst_row, count, dstColor);
+	if (srcConstant)
+		std::fill_n(src_row, count, srcColor);
+	blendRow(dst_row, src_row, count);
+	return MakeRuns(count, 0, 0, 0, 0, runs);
+}
+
+bool MyShaderFromShaders::isRowInvariant() const {
+	return myShaders[0] && myShaders[0]->isRowInvariant() && myShaders[1] && myShaders[1]->isRowInvariant();
+}
+
+bool MyShaderFromShaders::shadeInto(int i, int dst_x, int dst_y, int count, GPixel row[], GPixel* color) {
+	if (!myShaders[i]) {
+		shaders[i]->shadeRow(dst_x, dst_y, count, row);
+		return false;
+	}
+
+	Run runs[kMaxRuns];
+	int runCount = myShaders[i]->shadeSpan(dst_x, dst_y, count, row, runs);
+	if (runCount == 1 && runs[0].isConstant) {
+		*color = runs[0].color;
+		return true;
+	}
+
+	int offset = 0;
+	for (int r = 0; r < runCount; ++r) {
+		if (runs[r].isConstant)
+			std::fill_n(&row[offset], runs[r].count, runs[r].color);
+		offset += runs[r].count;
+	}
+	return false;
+}
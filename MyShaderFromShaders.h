@@ -0,0 +1,55 @@
+/*
+ *  Copyright 2015 Wesley Lo
+ */
+
+#include <vector>
+#include "MyBlend.h"
+#include "MyShader.h"
+
+/**
+ *  Composes two shaders into one: each pixel is shader b's color blended into shader a's with
+ *  the blend mode, as if b were drawn over a. Both are shaded into scratch spans and combined
+ *  before the single blend into the canvas, so a layered fill walks its edges and touches the
+ *  destination once. The shaders are not owned and must outlive this one.
+ */
+class MyShaderFromShaders: public MyShader {
+public:
+	MyShaderFromShaders(GShader* a, GShader* b, MyBlendMode mode);
+
+	/**
+	 *  Called before each use, this tells the shader the CTM for the current drawing.
+	 *  This returns true if the shader can handle the CTM, and therefore it is valid to call
+	 *  shadeRow(). If it cannot handle the CTM, this will return false, and shadeRow()
+	 *  should not be called.
+	 */
+	bool setContext(const float ctm[6]);
+
+	/**
+	 *  Given a row of pixels in device space [x, y] ... [x + count - 1, y], return the
+	 *  corresponding src pixels in row[0...count - 1]. The caller must ensure that row[]
+	 *  can hold at least [count] entries.
+	 */
+	void shadeRow(int x, int y, int count, GPixel row[]);
+
+	/**
+	 *  Where both shaders report a constant span the result is one constant run, blended once;
+	 *  otherwise the whole span is shaded.
+	 */
+	int shadeSpan(int x, int y, int count, GPixel row[], Run runs[kMaxRuns]);
+
+	/**
+	 *  True when both shaders are row invariant.
+	 */
+	bool isRowInvariant() const;
+
+protected:
+	GShader* shaders[2];
+	MyShader* myShaders[2]; // shaders[i], when it supports the MyShader queries
+	MyBlendMode mode;
+	MyBlendRowProc blendRow;
+	std::vector<GPixel> scratch; // shader b's span, grown to the widest span shaded so far
+
+	// Shade shaders[i] into row, filling in any constant runs; returns the color if the whole
+	// span was one constant run
+	bool shadeInto(int i, int x, int y, int count, GPixel row[], GPixel* color);
+};
@@ -0,0 +1,42 @@
+/*
+ *  Copyright 2015 Wesley Lo
+ */
+
+#include "GPoint.h"
+#include "GColor.h"
+#include "MyShader.h"
+
+/**
+ *  An angular gradient around center: colors[0] along the +x axis, turning clockwise (in y down
+ *  device space) to colors[1] just before coming back to it.
+ */
+class MyShaderFromSweepGradient: public MyShader {
+public:
+	MyShaderFromSweepGradient(const GPoint& center, const GColor colors[2]);
+
+	/**
+	 *  Called before each use, this tells the shader the CTM for the current drawing.
+	 *  This returns true if the shader can handle the CTM, and therefore it is valid to call
+	 *  shadeRow(). If it cannot handle the CTM, this will return false, and shadeRow()
+	 *  should not be called.
+	 */
+	bool setContext(const float ctm[6]);
+
+	/**
+	 *  Given a row of pixels in device space [x, y] ... [x + count - 1, y], return the
+	 *  corresponding src pixels in row[0...count - 1]. The caller must ensure that row[]
+	 *  can hold at least [count] entries.
+	 */
+	void shadeRow(int x, int y, int count, GPixel row[]);
+
+protected:
+	enum {
+		kLutSize = 256
+	};
+
+	GPoint center;
+	float inverse[6] = { 1, 0, 0, 0, 1, 0 }; // device to gradient space
+
+	// The gradient's premultiplied colors at t = 0, 1 / 255, ... 1
+	GPixel lut[kLutSize];
+};
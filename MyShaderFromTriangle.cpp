@@ -0,0 +1,155 @@
+/*
+ *  Copyright 2015 Wesley Lo
+ */
+
+#include <algorithm>
+#include <cmath>
+#include "MyShaderFromTriangle.h"
+#include "MyBlendKernels.h"
+#include "MyMatrix.h"
+
+// Pin a channel to [0, max] and round it to an integer
+static inline int pinChannel(float value, int max) {
+	return std::max(0, std::min((int) (value + 0.5f), max));
+}
+
+MyShaderFromTriangle::MyShaderFromTriangle(GShader* texture) {
+	this->texture = texture;
+	myTexture = dynamic_cast<MyShader*>(texture);
+}
+
+bool MyShaderFromTriangle::setTriangle(const GPoint device[3], const GColor colors[3], const GPoint texs[3]) {
+	// The edges from corner 0, as the columns of the matrix taking (s, t) to device space:
+	// corner 0 + s * (corner 1 - corner 0) + t * (corner 2 - corner 0)
+	const float toDevice[6] = {
+		device[1].fX - device[0].fX, device[2].fX - device[0].fX, device[0].fX,
+		device[1].fY - device[0].fY, device[2].fY - device[0].fY, device[0].fY,
+	};
+	float fromDevice[6];
+	if (!MyMatrix_Invert(toDevice, fromDevice))
+		return false;
+
+	hasColors = colors != NULL;
+	if (hasColors) {
+		float channels[3][4];
+		for (int i = 0; i < 3; ++i) {
+			GColor pinned = colors[i].pinToUnit();
+			float a = pinned.fA * 255;
+			channels[i][0] = a;
+			channels[i][1] = pinned.fR * a;
+			channels[i][2] = pinned.fG * a;
+			channels[i][3] = pinned.fB * a;
+		}
+
+		// Each channel is c0 + s * (c1 - c0) + t * (c2 - c0), with s and t from fromDevice
+		constantColor = true;
+		for (int c = 0; c < 4; ++c) {
+			float d1 = channels[1][c] - channels[0][c];
+			float d2 = channels[2][c] - channels[0][c];
+			dx[c] = d1 * fromDevice[0] + d2 * fromDevice[3];
+			dy[c] = d1 * fromDevice[1] + d2 * fromDevice[4];
+			origin[c] = channels[0][c] + d1 * fromDevice[2] + d2 * fromDevice[5];
+			constantColor = constantColor && d1 == 0 && d2 == 0;
+		}
+	}
+
+	if (!texture)
+		return hasColors;
+
+	// The texture's context takes texture coordinates to device space, through (s, t)
+	const float toTexture[6] = {
+		texs[1].fX - texs[0].fX, texs[2].fX - texs[0].fX, texs[0].fX,
+		texs[1].fY - texs[0].fY, texs[2].fY - texs[0].fY, texs[0].fY,
+	};
+	float fromTexture[6], context[6];
+	if (!MyMatrix_Invert(toTexture, fromTexture))
+		return false;
+	MyMatrix_Concat(toDevice, fromTexture, context);
+	return texture->setContext(context);
+}
+
+bool MyShaderFromTriangle::setContext(const float ctm[6]) {
+	return true;
+}
+
+void MyShaderFromTriangle::shadeRow(int dst_x, int dst_y, int count, GPixel dst_row[]) {
+	if (!texture) {
+		shadeColors(dst_x, dst_y, count, dst_row);
+		return;
+	}
+
+	texture->shadeRow(dst_x, dst_y, count, dst_row);
+	if (!hasColors)
+		return;
+
+	// Modulate a chunk at a time, so the colors fit in a fixed buffer
+	GPixel colors[kChunkSize];
+	for (int start = 0; start < count; start += kChunkSize) {
+		int n = std::min((int) kChunkSize, count - start);
+		shadeColors(dst_x + start, dst_y, n, colors);
+		for (int i = 0; i < n; ++i) {
+			GPixel texel = dst_row[start + i];
+			GPixel color = colors[i];
+			dst_row[start + i] = GPixel_PackARGB(div255(GPixel_GetA(texel) * GPixel_GetA(color)),
+					div255(GPixel_GetR(texel) * GPixel_GetR(color)), div255(GPixel_GetG(texel) * GPixel_GetG(color)),
+					div255(GPixel_GetB(texel) * GPixel_GetB(color)));
+		}
+	}
+}
+
+void MyShaderFromTriangle::shadeColors(int dst_x, int dst_y, int count, GPixel colors[]) const {
+	// Sample at the center of each device pixel
+	float start[4];
+	float range = 0;
+	for (int c = 0; c < 4; ++c) {
+		start[c] = origin[c] + dx[c] * (dst_x + 0.5f) + dy[c] * (dst_y + 0.5f);
+		range = std::max(range, fabsf(start[c]) + fabsf(dx[c]) * count);
+	}
+
+	// Centers just outside the triangle can step a little past a valid premultiplied color, so
+	// each channel is pinned (r, g, b to a)
+	if (range < kFixedRange) {
+		// Step the channels in 16.16 fixed point, rounding
+		int a = (int) (start[0] * 65536) + 32768;
+		int r = (int) (start[1] * 65536) + 32768;
+		int g = (int) (start[2] * 65536) + 32768;
+		int b = (int) (start[3] * 65536) + 32768;
+		const int da = (int) (dx[0] * 65536);
+		const int dr = (int) (dx[1] * 65536);
+		const int dg = (int) (dx[2] * 65536);
+		const int db = (int) (dx[3] * 65536);
+		for (int i = 0; i < count; ++i) {
+			int pa = std::max(0, std::min(a >> 16, 255));
+			colors[i] = GPixel_PackARGB(pa, std::max(0, std::min(r >> 16, pa)), std::max(0, std::min(g >> 16, pa)),
+					std::max(0, std::min(b >> 16, pa)));
+			a += da;
+			r += dr;
+			g += dg;
+			b += db;
+		}
+		return;
+	}
+
+	for (int i = 0; i < count; ++i) {
+		int pa = pinChannel(start[0] + dx[0] * i, 255);
+		colors[i] = GPixel_PackARGB(pa, pinChannel(start[1] + dx[1] * i, pa), pinChannel(start[2] + dx[2] * i, pa),
+				pinChannel(start[3] + dx[3] * i, pa));
+	}
+}
+
+int MyShaderFromTriangle::shadeSpan(int dst_x, int dst_y, int count, GPixel dst_row[], Run runs[kMaxRuns]) {
+	if (count <= 0)
+		return 0;
+
+	if (!hasColors && myTexture)
+		return myTexture->shadeSpan(dst_x, dst_y, count, dst_row, runs);
+
+	if (hasColors && constantColor && !texture) {
+		int a = pinChannel(origin[0], 255);
+		runs[0] = { count, true, GPixel_PackARGB(a, pinChannel(origin[1], a), pinChannel(origin[2], a), pinChannel(origin[3], a)) };
+		return 1;
+	}
+
+	shadeRow(dst_x, dst_y, count, dst_row);
+	return MakeRuns(count, 0, 0, 0, 0, runs);
+}
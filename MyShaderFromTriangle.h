@@ -0,0 +1,73 @@
+/*
+ *  Copyright 2015 Wesley Lo
+ */
+
+#ifndef MyShaderFromTriangle_DEFINED
+#define MyShaderFromTriangle_DEFINED
+
+#include "GColor.h"
+#include "GPoint.h"
+#include "MyShader.h"
+
+/**
+ *  The colors of one triangle of a mesh, set with setTriangle() before its spans are shaded, so
+ *  one shader (and one pipeline) draws every triangle of the mesh. Vertex colors are
+ *  interpolated across the triangle (premultiplied), stepping from the start of each span by
+ *  their change per pixel. A texture shader is mapped so each vertex's texture coordinates land
+ *  on it, and its colors are modulated by the vertex colors, if there are any. The texture is
+ *  not owned and must outlive this shader.
+ */
+class MyShaderFromTriangle: public MyShader {
+public:
+	/**
+	 *  texture may be NULL, in which case every triangle must have colors.
+	 */
+	MyShaderFromTriangle(GShader* texture);
+
+	/**
+	 *  Shade the triangle with device space corners device[], colored colors[] (or NULL for
+	 *  just the texture), with texture coordinates texs[] (ignored without a texture). Returns
+	 *  false if the triangle can't be shaded: it has no area, or its texture coordinates don't.
+	 */
+	bool setTriangle(const GPoint device[3], const GColor colors[3], const GPoint texs[3]);
+
+	/**
+	 *  The triangle is given in device space, so this only returns true.
+	 */
+	bool setContext(const float ctm[6]);
+
+	/**
+	 *  Given a row of pixels in device space [x, y] ... [x + count - 1, y], return the
+	 *  corresponding src pixels in row[0...count - 1]. The caller must ensure that row[]
+	 *  can hold at least [count] entries.
+	 */
+	void shadeRow(int x, int y, int count, GPixel row[]);
+
+	/**
+	 *  A triangle whose vertices share one color and has no texture is one constant run;
+	 *  without colors, the texture's own runs are passed on.
+	 */
+	int shadeSpan(int x, int y, int count, GPixel row[], Run runs[kMaxRuns]);
+
+protected:
+	enum {
+		// Spans whose channels stay within +-kFixedRange are stepped in fixed point
+		kFixedRange = 1024,
+
+		// Textured spans are modulated by the colors this many pixels at a time
+		kChunkSize = 64
+	};
+
+	GShader* texture;
+	MyShader* myTexture; // texture, when it supports the MyShader queries
+	bool hasColors = false;
+	bool constantColor = false;
+
+	// Premultiplied a, r, g, b in [0, 255] at device (x, y): origin + dx * x + dy * y
+	float origin[4], dx[4], dy[4];
+
+	// The interpolated vertex colors of the span, pinned to valid premultiplied pixels
+	void shadeColors(int x, int y, int count, GPixel colors[]) const;
+};
+
+#endif
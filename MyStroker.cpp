@@ -0,0 +1,207 @@
+/*
+ *  Copyright 2015 Wesley Lo
+ */
+
+#include <algorithm>
+#include <cmath>
+#include "MyStroker.h"
+
+static inline GPoint add(const GPoint& a, const GPoint& b) {
+	return GPoint::Make(a.fX + b.fX, a.fY + b.fY);
+}
+
+static inline GPoint sub(const GPoint& a, const GPoint& b) {
+	return GPoint::Make(a.fX - b.fX, a.fY - b.fY);
+}
+
+static inline GPoint scale(const GPoint& p, float s) {
+	return GPoint::Make(p.fX * s, p.fY * s);
+}
+
+static inline float dot(const GPoint& a, const GPoint& b) {
+	return a.fX * b.fX + a.fY * b.fY;
+}
+
+static inline float cross(const GPoint& a, const GPoint& b) {
+	return a.fX * b.fY - a.fY * b.fX;
+}
+
+static const float kPi = 3.14159265f;
+
+// Chords may stray this far (in device pixels) inside the circle they approximate
+static const float kArcTolerance = 0.25f;
+
+MyStroker::MyStroker(const GCanvas::Stroke& stroke, MyRasterizer& rasterizer, Join join, Cap cap)
+		: rasterizer(rasterizer) {
+	radius = stroke.fWidth / 2;
+	miterLimit = stroke.fMiterLimit;
+	addCap = stroke.fAddCap;
+	joinStyle = join;
+	capStyle = cap;
+
+	// A chord spanning angle a sits r * (1 - cos(a / 2)) inside a circle of radius r
+	float deviceRadius = radius * rasterizer.deviceScale();
+	arcStep = deviceRadius > kArcTolerance ? 2 * acosf(1 - kArcTolerance / deviceRadius) : kPi;
+}
+
+void MyStroker::moveTo(const GPoint& p) {
+	first = last = p;
+}
+
+void MyStroker::lineTo(const GPoint& p) {
+	rasterizer.addEdge(last, p);
+	last = p;
+}
+
+void MyStroker::close() {
+	rasterizer.addEdge(last, first);
+	last = first;
+}
+
+void MyStroker::arcTo(const GPoint& center, const GPoint& from, const GPoint& to, float angle) {
+	int count = std::max(1, (int) ceilf(fabsf(angle) / arcStep));
+	float c = cosf(angle / count);
+	float s = sinf(angle / count);
+	GPoint p = from;
+	for (int i = 1; i < count; ++i) {
+		p = GPoint::Make(p.fX * c - p.fY * s, p.fX * s + p.fY * c);
+		lineTo(add(center, p));
+	}
+	lineTo(add(center, to));
+}
+
+GPoint MyStroker::offset(int i) const {
+	GPoint d = sub(points[i + 1], points[i]);
+	float s = radius / sqrtf(dot(d, d));
+	return GPoint::Make(-d.fY * s, d.fX * s);
+}
+
+void MyStroker::join(const GPoint& pivot, const GPoint& before, const GPoint& after) {
+	// The outgoing segment's direction is after turned back a quarter turn
+	GPoint direction = GPoint::Make(after.fY, -after.fX);
+	if (dot(direction, before) > 0) {
+		// Turning towards this side: the offset segments overlap, so just pass through the pivot
+		lineTo(pivot);
+		lineTo(add(pivot, after));
+		return;
+	}
+
+	if (joinStyle == kRoundJoin) {
+		// A reversal has no shorter way around, so go around the front like a round cap
+		float angle = atan2f(cross(before, after), dot(before, after));
+		if (cross(before, after) == 0 && dot(before, after) < 0)
+			angle = -kPi;
+		arcTo(pivot, before, after, angle);
+		return;
+	}
+
+	// Outer corner. The miter tip is (before + after) / (1 + cos) from the pivot, and its
+	// length over the stroke radius is 1 / cos(half the angle between the offsets).
+	float cosine = dot(before, after) / (radius * radius);
+	float halfCos = sqrtf(std::max(0.0f, (1 + cosine) / 2));
+	if (halfCos > 0 && 1 / halfCos <= miterLimit)
+		lineTo(add(pivot, scale(add(before, after), 1 / (1 + cosine))));
+	lineTo(add(pivot, after));
+}
+
+void MyStroker::strokePolyline(const GPoint pts[], int count, bool isClosed) {
+	if (collect(pts, count, isClosed) >= 2)
+		outline(isClosed);
+}
+
+void MyStroker::StrokeDash(void* context, const GPoint pts[], int count, const GPoint& direction) {
+	MyStroker* stroker = (MyStroker*) context;
+	int n = stroker->collect(pts, count, false);
+	if (n >= 2)
+		stroker->outline(false);
+	else if (n == 1)
+		stroker->strokeDot(stroker->points[0], direction);
+}
+
+void MyStroker::strokeDot(const GPoint& center, const GPoint& direction) {
+	if (!addCap)
+		return;
+
+	GPoint along = scale(direction, radius);
+	GPoint across = GPoint::Make(-along.fY, along.fX);
+	if (capStyle == kRoundCap) {
+		moveTo(add(center, across));
+		arcTo(center, across, scale(across, -1), -kPi);
+		arcTo(center, scale(across, -1), across, -kPi);
+	} else {
+		moveTo(sub(add(center, across), along));
+		lineTo(add(add(center, across), along));
+		lineTo(sub(add(center, along), across));
+		lineTo(sub(sub(center, along), across));
+	}
+	close();
+}
+
+int MyStroker::collect(const GPoint pts[], int count, bool isClosed) {
+	if (!(radius > 0))
+		return 0;
+
+	points.clear();
+	for (int i = 0; i < count; ++i) {
+		if (points.empty() || pts[i].fX != points.back().fX || pts[i].fY != points.back().fY)
+			points.push_back(pts[i]);
+	}
+	if (isClosed && points.size() > 1 && points.front().fX == points.back().fX && points.front().fY == points.back().fY)
+		points.pop_back();
+
+	return points.size();
+}
+
+void MyStroker::outline(bool isClosed) {
+	const int n = points.size();
+	if (isClosed && n > 2) {
+		// Left side all the way around, then the right side backwards
+		points.push_back(points[0]);
+		moveTo(add(points[0], offset(0)));
+		for (int i = 1; i <= n; ++i) {
+			lineTo(add(points[i], offset(i - 1)));
+			join(points[i], offset(i - 1), offset(i % n));
+		}
+		close();
+
+		moveTo(sub(points[0], offset(n - 1)));
+		for (int i = n - 1; i >= 0; --i) {
+			lineTo(sub(points[i], offset(i)));
+			join(points[i], scale(offset(i), -1), scale(offset((i + n - 1) % n), -1));
+		}
+		close();
+		return;
+	}
+
+	// Open (or a closed line of two points, which is the same): out along the left side,
+	// around the end cap, back along the right side and around the start cap. A cap extends
+	// the end by the stroke radius; turning the offset a quarter turn gives that along the line.
+	GPoint startOffset = offset(0);
+	GPoint endOffset = offset(n - 2);
+	GPoint startCap = GPoint::Make(0, 0);
+	GPoint endCap = GPoint::Make(0, 0);
+	bool roundCaps = addCap && capStyle == kRoundCap;
+	if (addCap && !roundCaps) {
+		startCap = GPoint::Make(-startOffset.fY, startOffset.fX);
+		endCap = GPoint::Make(endOffset.fY, -endOffset.fX);
+	}
+
+	moveTo(add(add(points[0], startOffset), startCap));
+	for (int i = 1; i < n - 1; ++i) {
+		lineTo(add(points[i], offset(i - 1)));
+		join(points[i], offset(i - 1), offset(i));
+	}
+	lineTo(add(add(points[n - 1], endOffset), endCap));
+	if (roundCaps)
+		arcTo(points[n - 1], endOffset, scale(endOffset, -1), -kPi);
+	else
+		lineTo(add(sub(points[n - 1], endOffset), endCap));
+	for (int i = n - 2; i > 0; --i) {
+		lineTo(sub(points[i], offset(i)));
+		join(points[i], scale(offset(i), -1), scale(offset(i - 1), -1));
+	}
+	lineTo(add(sub(points[0], startOffset), startCap));
+	if (roundCaps)
+		arcTo(points[0], scale(startOffset, -1), startOffset, -kPi);
+	close();
+}
@@ -0,0 +1,92 @@
+/*
+ *  Copyright 2015 Wesley Lo
+ */
+
+#ifndef MyStroker_DEFINED
+#define MyStroker_DEFINED
+
+#include <vector>
+#include "GCanvas.h"
+#include "MyRasterizer.h"
+
+/**
+ *  Turns a polyline into the outline of its stroke, as edges added to a MyRasterizer: one
+ *  closed contour for an open polyline (out along one side, back along the other, with the end
+ *  caps), or two for a closed one (each side all the way around). Outer corners get a miter,
+ *  or a bevel where the miter would be longer than the miter limit allows; inner corners pass
+ *  through the vertex. Filled with nonzero winding, every pixel of the stroke is covered once.
+ */
+class MyStroker {
+public:
+	/**
+	 *  How outer corners are drawn. kMiterJoin extends the sides to a point, or cuts the corner
+	 *  off (a bevel) past the Stroke's miter limit; kRoundJoin rounds it with an arc.
+	 */
+	enum Join {
+		kMiterJoin,
+		kRoundJoin
+	};
+
+	/**
+	 *  The shape of the ends of open polylines, when the Stroke's fAddCap asks for caps: a
+	 *  square, or a half circle, reaching half the stroke width past the end point.
+	 */
+	enum Cap {
+		kSquareCap,
+		kRoundCap
+	};
+
+	MyStroker(const GCanvas::Stroke&, MyRasterizer&, Join = kMiterJoin, Cap = kSquareCap);
+
+	void strokePolyline(const GPoint pts[], int count, bool isClosed);
+
+	/**
+	 *  A MyDash::DashProc stroking each dash (context is the MyStroker) as an open polyline.
+	 *  Dashes of zero length get just their caps, facing direction.
+	 */
+	static void StrokeDash(void* context, const GPoint pts[], int count, const GPoint& direction);
+
+private:
+	MyRasterizer& rasterizer;
+	float radius;
+	float miterLimit;
+	bool addCap;
+	Join joinStyle;
+	Cap capStyle;
+
+	// The angle of each chord of an arc, small enough that the chords stay within a quarter of
+	// a pixel of the circle at the CTM's scale
+	float arcStep;
+
+	// The contour being built: its first point, and the last point added
+	GPoint first, last;
+
+	// The polyline without repeated points
+	std::vector<GPoint> points;
+
+	// Copy the polyline into points, dropping repeated points; returns how many are left, or 0
+	// if the stroke draws nothing
+	int collect(const GPoint pts[], int count, bool isClosed);
+
+	// Add the outline of the polyline in points
+	void outline(bool isClosed);
+
+	// Add the caps of a polyline of zero length at center, facing direction (a unit vector)
+	void strokeDot(const GPoint& center, const GPoint& direction);
+
+	void moveTo(const GPoint&);
+	void lineTo(const GPoint&);
+	void close();
+
+	// Add chords around center from center + from, turning by angle (radians, positive from
+	// +x towards +y), ending exactly at center + to
+	void arcTo(const GPoint& center, const GPoint& from, const GPoint& to, float angle);
+
+	// The offset of the segment from points[i] to points[i + 1] on its left side
+	GPoint offset(int i) const;
+
+	// Join the segment arriving at pivot (offset by before) to the one leaving it (offset by after)
+	void join(const GPoint& pivot, const GPoint& before, const GPoint& after);
+};
+
+#endif
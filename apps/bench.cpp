@@ -0,0 +1,229 @@
+/**
+ *  Copyright 2015 Wesley Lo
+ *
+ *  Times a few draws whose cost is mostly per span (thin strokes, tiny rects, narrow bitmap
+ *  columns) next to one whose cost is mostly per pixel (a big rect).
+ *
+ *      ./bench [repeat count]
+ */
+
+#include "GTime.h"
+#include "MyCanvas.h"
+#include "MyShaderFromLinearGradient.h"
+#include "MyShaderFromNoise.h"
+#include "MyShaderFromRadialGradient.h"
+#include "MyShaderFromSweepGradient.h"
+#include <cstdio>
+#include <cstdlib>
+
+static const int kSize = 512;
+
+struct Bench {
+    const char* fName;
+    int         fLoops;
+    void        (*fProc)(MyCanvas&, const GBitmap& dst, const GBitmap& src);
+};
+
+static void thin_strokes(MyCanvas& canvas, const GBitmap&, const GBitmap&) {
+    GShader* shader = GShader::FromColor(GColor::MakeARGB(0.5f, 0.2f, 0.4f, 0.8f));
+    GCanvas::Stroke stroke = { 1, 4, false };
+    for (int i = 0; i < 64; ++i) {
+        GPoint pts[2] = { { 3.0f + i * 7, 2.0f }, { 500.0f - i * 5, 510.0f } };
+        canvas.strokePolygon(pts, 2, false, stroke, shader);
+    }
+    delete shader;
+}
+
+// Short solid color lines, as a plot or wireframe draws them
+static void hairlines(MyCanvas& canvas, const GBitmap&, const GBitmap&) {
+    GCanvas::Stroke stroke = { 1, 4, false };
+    const GColor color = GColor::MakeARGB(1, 0.2f, 0.4f, 0.8f);
+    for (int i = 0; i < 4096; ++i) {
+        float x = (i * 37) % 480 + 16.0f;
+        float y = (i * 101) % 480 + 16.0f;
+        canvas.strokeLine(GPoint::Make(x, y), GPoint::Make(x + (i % 31) - 15, y + (i % 29) - 14), stroke, color);
+    }
+}
+
+// Circles of radius 4 to 35, as the draw app's shapes and chart markers use them
+static void circles(MyCanvas& canvas, const GBitmap&, const GBitmap&) {
+    for (int i = 0; i < 256; ++i) {
+        float x = (i * 37) % 448 + 32.0f;
+        float y = (i * 101) % 448 + 32.0f;
+        float r = 4 + i % 32;
+        canvas.fillOval(GRect::MakeLTRB(x - r, y - r, x + r, y + r), GColor::MakeARGB(0.5f, 0.9f, 0.3f, 0.1f));
+    }
+}
+
+// UI sized rounded rects, 24 to 87 by 16 to 47 with 4 pixel corners
+static void rounded_rects(MyCanvas& canvas, const GBitmap&, const GBitmap&) {
+    const float radii[4] = { 4, 4, 4, 4 };
+    for (int i = 0; i < 256; ++i) {
+        float x = (i * 37) % 400 + 8.0f;
+        float y = (i * 101) % 440 + 8.0f;
+        canvas.fillRRect(GRect::MakeXYWH(x, y, 24 + i % 64, 16 + i % 32), radii, GColor::MakeARGB(1, 0.3f, 0.3f, 0.9f));
+    }
+}
+
+// Small triangles, as a mesh or particle system draws them, in one batch
+static void triangle_batch(MyCanvas& canvas, const GBitmap&, const GBitmap&) {
+    const int kCount = 8192;
+    static GPoint pts[kCount * 3];
+    static int counts[kCount];
+    static GColor colors[kCount];
+    for (int i = 0; i < kCount; ++i) {
+        float x = (i * 37) % 500 + 2.0f;
+        float y = (i * 101) % 500 + 2.0f;
+        pts[i * 3 + 0] = GPoint::Make(x, y);
+        pts[i * 3 + 1] = GPoint::Make(x + 8, y + 2);
+        pts[i * 3 + 2] = GPoint::Make(x + 3, y + 9);
+        counts[i] = 3;
+        colors[i] = GColor::MakeARGB(1, (i % 7) / 7.0f, (i % 11) / 11.0f, 0.5f);
+    }
+    canvas.fillConvexPolygons(pts, counts, kCount, colors);
+}
+
+// A 32 x 32 grid of cells over the canvas, two triangles each, colored per vertex
+static void vertex_mesh(MyCanvas& canvas, const GBitmap&, const GBitmap&) {
+    const int kCells = 32;
+    const float kCell = (float) kSize / kCells;
+    static GPoint pts[kCells * kCells * 6];
+    static GColor colors[kCells * kCells * 6];
+    int n = 0;
+    for (int y = 0; y < kCells; ++y) {
+        for (int x = 0; x < kCells; ++x) {
+            const int corners[6][2] = { { 0, 0 }, { 1, 0 }, { 1, 1 }, { 0, 0 }, { 1, 1 }, { 0, 1 } };
+            for (int i = 0; i < 6; ++i) {
+                int cx = x + corners[i][0], cy = y + corners[i][1];
+                pts[n] = GPoint::Make(cx * kCell, cy * kCell);
+                colors[n] = GColor::MakeARGB(1, cx / (float) kCells, cy / (float) kCells, ((cx + cy) % 3) / 2.0f);
+                ++n;
+            }
+        }
+    }
+    canvas.drawVertices(MyCanvas::kTriangles, n, pts, colors, NULL, NULL);
+}
+
+static void tiny_rects(MyCanvas& canvas, const GBitmap&, const GBitmap&) {
+    for (int y = 0; y < kSize; y += 4) {
+        for (int x = 0; x < kSize; x += 4) {
+            canvas.fillRect(GRect::MakeXYWH(x, y, 3, 3), GColor::MakeARGB(0.5f, x / 512.0f, y / 512.0f, 0.5f));
+        }
+    }
+}
+
+static void bitmap_columns(MyCanvas& canvas, const GBitmap&, const GBitmap& src) {
+    for (int x = 0; x < kSize; x += 2) {
+        canvas.fillBitmapRect(src, GRect::MakeXYWH(x, 0, 1, kSize));
+    }
+}
+
+// Spans of 1 to 4 pixels straight into a pipeline, so little but the per span cost is left
+static void short_spans(MyCanvas&, const GBitmap& dst, const GBitmap&) {
+    GShader* shader = GShader::FromColor(GColor::MakeARGB(0.5f, 0.2f, 0.4f, 0.8f));
+    const float identity[6] = { 1, 0, 0, 0, 1, 0 };
+    shader->setContext(identity);
+    const uint8_t coverage[4] = { 64, 255, 255, 128 };
+
+    MyPipeline pipeline(dst, shader);
+    for (int y = 0; y < kSize; ++y) {
+        for (int x = 0; x + 4 <= kSize; x += 5) {
+            pipeline.run(x, y, 1 + (x & 3), (y & 1) ? coverage : NULL);
+        }
+    }
+    delete shader;
+}
+
+static void big_rect(MyCanvas& canvas, const GBitmap&, const GBitmap&) {
+    canvas.fillRect(GRect::MakeWH(kSize, kSize), GColor::MakeARGB(0.5f, 0.1f, 0.9f, 0.3f));
+}
+
+static const GColor gGradientColors[2] = {
+    GColor::MakeARGB(1, 0.9f, 0.3f, 0.1f), GColor::MakeARGB(1, 0.1f, 0.4f, 0.8f)
+};
+
+static void linear_gradient(MyCanvas& canvas, const GBitmap&, const GBitmap&) {
+    const GPoint pts[2] = { GPoint::Make(0, 0), GPoint::Make(kSize, kSize) };
+    MyShaderFromLinearGradient shader(pts, gGradientColors);
+    canvas.shadeRect(GRect::MakeWH(kSize, kSize), &shader);
+}
+
+static void sweep_gradient(MyCanvas& canvas, const GBitmap&, const GBitmap&) {
+    MyShaderFromSweepGradient shader(GPoint::Make(kSize / 2, kSize / 2), gGradientColors);
+    canvas.shadeRect(GRect::MakeWH(kSize, kSize), &shader);
+}
+
+static void noise(MyCanvas& canvas, const GBitmap&, const GBitmap&) {
+    MyShaderFromNoise shader(gGradientColors, 1 / 32.0f, 4, 7);
+    canvas.shadeRect(GRect::MakeWH(kSize, kSize), &shader);
+}
+
+// The same radial gradient every loop, as an animation redrawing a static background would
+static void radial_gradient(MyCanvas& canvas, bool caching) {
+    static MyShaderFromRadialGradient shader(GPoint::Make(kSize / 2, kSize / 2), kSize / 2, gGradientColors);
+    canvas.setShaderCaching(caching);
+    canvas.shadeRect(GRect::MakeWH(kSize, kSize), &shader);
+    canvas.setShaderCaching(false);
+}
+
+static void radial_gradient(MyCanvas& canvas, const GBitmap&, const GBitmap&) {
+    radial_gradient(canvas, false);
+}
+
+static void radial_gradient_cached(MyCanvas& canvas, const GBitmap&, const GBitmap&) {
+    radial_gradient(canvas, true);
+}
+
+static const Bench gBenches[] = {
+    { "thin_strokes",   200,   thin_strokes },
+    { "hairlines",      200,   hairlines },
+    { "circles",        200,   circles },
+    { "rounded_rects",  200,   rounded_rects },
+    { "triangle_batch", 100,   triangle_batch },
+    { "vertex_mesh",    200,   vertex_mesh },
+    { "tiny_rects",     200,   tiny_rects },
+    { "bitmap_columns", 200,   bitmap_columns },
+    { "short_spans",    100,   short_spans },
+    { "big_rect",       2000,  big_rect },
+    { "linear_gradient", 500,  linear_gradient },
+    { "sweep_gradient",  500,  sweep_gradient },
+    { "noise",           100,  noise },
+    { "radial_gradient", 500,  radial_gradient },
+    { "radial_cached",   500,  radial_gradient_cached },
+};
+
+static void make_bitmap(GBitmap* bitmap, int width, int height, GPixel pixel) {
+    bitmap->fWidth = width;
+    bitmap->fHeight = height;
+    bitmap->fRowBytes = width * sizeof(GPixel);
+    bitmap->fPixels = (GPixel*)malloc(bitmap->fRowBytes * height);
+    for (int i = 0; i < width * height; ++i) {
+        bitmap->fPixels[i] = pixel;
+    }
+}
+
+int main(int argc, char** argv) {
+    int repeat = argc > 1 ? atoi(argv[1]) : 1;
+    if (repeat < 1) {
+        repeat = 1;
+    }
+
+    GBitmap dst, src;
+    make_bitmap(&dst, kSize, kSize, GPixel_PackARGB(0xFF, 0x20, 0x40, 0x80));
+    make_bitmap(&src, 64, 64, GPixel_PackARGB(0x80, 0x40, 0x40, 0x40));
+    MyCanvas canvas(dst);
+
+    for (size_t i = 0; i < sizeof(gBenches) / sizeof(gBenches[0]); ++i) {
+        const Bench& bench = gBenches[i];
+        GMSec now = GTime::GetMSec();
+        for (int loop = 0; loop < bench.fLoops * repeat; ++loop) {
+            bench.fProc(canvas, dst, src);
+        }
+        GMSec dur = GTime::GetMSec() - now;
+        printf("%-16s %8.3f ms/loop\n", bench.fName, (double)dur / (bench.fLoops * repeat));
+    }
+
+    free(dst.fPixels);
+    free(src.fPixels);
+    return 0;
+}
@@ -8,6 +8,11 @@
 #include "GPoint.h"
 #include "GRect.h"
 #include "tests.h"
+#include "MyCanvas.h"
+#include "MyShaderFromLinearGradient.h"
+#include "MyShaderFromNoise.h"
+#include "MyShaderFromShaders.h"
+#include "MyShaderFromSweepGradient.h"
 
 static void setup_bitmap(GBitmap* bitmap, int w, int h) {
     bitmap->fWidth = w;
@@ -260,6 +265,993 @@ static void test_shrink_bitmap(GTestStats* stats) {
     }
 }
 
+static void test_rotate_bitmap(GTestStats* stats) {
+    GPixel srcStorage[16];
+    for (int i = 0; i < 16; ++i) {
+        srcStorage[i] = GPixel_PackARGB(0xFF, i * 16, 0xFF - i * 16, i);
+    }
+
+    GBitmap src;
+    src.fWidth = src.fHeight = 4;
+    src.fRowBytes = src.fWidth * sizeof(GPixel);
+    src.fPixels = srcStorage;
+
+    GPixel dstStorage[16];
+    GBitmap dst;
+    dst.fWidth = dst.fHeight = 4;
+    dst.fRowBytes = dst.fWidth * sizeof(GPixel);
+    dst.fPixels = dstStorage;
+    memset(dst.fPixels, 0, sizeof(dstStorage));
+
+    GCanvas* canvas = GCanvas::Create(dst);
+
+    // rotating by 90 degrees about the canvas' top/right corner should transpose the bitmap
+    canvas->translate(4, 0);
+    canvas->rotate(M_PI / 2);
+    canvas->fillBitmapRect(src, GRect::MakeWH(4, 4));
+
+    for (int y = 0; y < dst.height(); ++y) {
+        for (int x = 0; x < dst.width(); ++x) {
+            stats->expectEQ(*dst.getAddr(x, y), *src.getAddr(y, 3 - x), "rotate_bitmap");
+        }
+    }
+    delete canvas;
+}
+
+static void test_bilinear_bitmap(GTestStats* stats) {
+    GPixel srcStorage[2] = {
+        GPixel_PackARGB(0xFF, 0, 0, 0),
+        GPixel_PackARGB(0xFF, 0xFF, 0xFF, 0xFF),
+    };
+    GBitmap src;
+    src.fWidth = 2;
+    src.fHeight = 1;
+    src.fRowBytes = src.fWidth * sizeof(GPixel);
+    src.fPixels = srcStorage;
+
+    GPixel dstStorage[4];
+    GBitmap dst;
+    dst.fWidth = 4;
+    dst.fHeight = 1;
+    dst.fRowBytes = dst.fWidth * sizeof(GPixel);
+    dst.fPixels = dstStorage;
+    memset(dst.fPixels, 0, sizeof(dstStorage));
+
+    // stretching 2 pixels over 4 should ramp from black to white, clamping at the ends
+    MyCanvas canvas(dst);
+    canvas.setFilterQuality(MyShaderFromBitmap::kBilinear);
+    canvas.fillBitmapRect(src, GRect::MakeWH(4, 1));
+
+    const GPixel expected[4] = {
+        GPixel_PackARGB(0xFF, 0, 0, 0),
+        GPixel_PackARGB(0xFF, 63, 63, 63),
+        GPixel_PackARGB(0xFF, 191, 191, 191),
+        GPixel_PackARGB(0xFF, 0xFF, 0xFF, 0xFF),
+    };
+    for (int x = 0; x < dst.width(); ++x) {
+        stats->expectEQ(*dst.getAddr(x, 0), expected[x], "bilinear_bitmap");
+    }
+}
+
+static void check_tiled_row(GTestStats* stats, int srcWidth, MyShaderFromBitmap::TileMode mode,
+                            const int expectedIndex[8], const char name[]) {
+    GPixel srcStorage[3] = {
+        GPixel_PackARGB(0xFF, 0xFF, 0, 0),
+        GPixel_PackARGB(0xFF, 0, 0xFF, 0),
+        GPixel_PackARGB(0xFF, 0, 0, 0xFF),
+    };
+    GBitmap src;
+    src.fWidth = srcWidth;
+    src.fHeight = 1;
+    src.fRowBytes = src.fWidth * sizeof(GPixel);
+    src.fPixels = srcStorage;
+
+    GPixel dstStorage[8];
+    GBitmap dst;
+    dst.fWidth = 8;
+    dst.fHeight = 1;
+    dst.fRowBytes = dst.fWidth * sizeof(GPixel);
+    dst.fPixels = dstStorage;
+    memset(dst.fPixels, 0, sizeof(dstStorage));
+
+    const float localMatrix[6] = { 1, 0, 0, 0, 1, 0 };
+    MyShaderFromBitmap shader(src, localMatrix, MyShaderFromBitmap::kNearest, mode, mode);
+    MyCanvas canvas(dst);
+    canvas.shadeRect(GRect::MakeWH(8, 1), &shader);
+
+    for (int x = 0; x < dst.width(); ++x) {
+        stats->expectEQ(*dst.getAddr(x, 0), srcStorage[expectedIndex[x]], name);
+    }
+}
+
+static void test_tiled_bitmap(GTestStats* stats) {
+    // 3 wide exercises the wrapped stepping, 2 wide the power of two mask
+    const int repeat3[8] = { 0, 1, 2, 0, 1, 2, 0, 1 };
+    const int mirror3[8] = { 0, 1, 2, 2, 1, 0, 0, 1 };
+    const int repeat2[8] = { 0, 1, 0, 1, 0, 1, 0, 1 };
+    const int mirror2[8] = { 0, 1, 1, 0, 0, 1, 1, 0 };
+    check_tiled_row(stats, 3, MyShaderFromBitmap::kRepeat, repeat3, "tiled_bitmap_repeat");
+    check_tiled_row(stats, 3, MyShaderFromBitmap::kMirror, mirror3, "tiled_bitmap_mirror");
+    check_tiled_row(stats, 2, MyShaderFromBitmap::kRepeat, repeat2, "tiled_bitmap_repeat_pow2");
+    check_tiled_row(stats, 2, MyShaderFromBitmap::kMirror, mirror2, "tiled_bitmap_mirror_pow2");
+}
+
+// A bitmap too wide to step its mirrored period in 16.16 must still tile correctly
+static void test_wide_mirrored_bitmap(GTestStats* stats) {
+    const int kWidth = 9000;
+    std::vector<GPixel> srcStorage(kWidth);
+    for (int i = 0; i < kWidth; ++i) {
+        srcStorage[i] = GPixel_PackARGB(0xFF, i >> 8, i & 0xFF, 0);
+    }
+    GBitmap src;
+    src.fWidth = kWidth;
+    src.fHeight = 1;
+    src.fRowBytes = src.fWidth * sizeof(GPixel);
+    src.fPixels = srcStorage.data();
+
+    // each device pixel steps most of the 18000 pixel period, starting near its end
+    const float step = 17999.5f;
+    const float localMatrix[6] = { 1 / step, 0, -17990 / step, 0, 1, 0 };
+    MyShaderFromBitmap shader(src, localMatrix, MyShaderFromBitmap::kNearest, MyShaderFromBitmap::kMirror,
+                              MyShaderFromBitmap::kMirror);
+    const float identity[6] = { 1, 0, 0, 0, 1, 0 };
+    shader.setContext(identity);
+
+    GPixel row[8];
+    shader.shadeRow(0, 0, 8, row);
+    bool tiled = true;
+    for (int x = 0; x < 8; ++x) {
+        float u = fmodf(17990 + (x + 0.5f) * step, 2.0f * kWidth);
+        int expected = u < kWidth ? (int) u : 2 * kWidth - 1 - (int) u;
+        int index = GPixel_GetR(row[x]) << 8 | GPixel_GetG(row[x]);
+        tiled &= abs(index - expected) <= 1;
+    }
+    stats->expectTrue(tiled, "wide_mirrored_bitmap");
+}
+
+static void test_clamped_span_runs(GTestStats* stats) {
+    GPixel srcStorage[3] = {
+        GPixel_PackARGB(0xFF, 0xFF, 0, 0),
+        GPixel_PackARGB(0xFF, 0, 0xFF, 0),
+        GPixel_PackARGB(0xFF, 0, 0, 0xFF),
+    };
+    GBitmap src;
+    src.fWidth = 3;
+    src.fHeight = 1;
+    src.fRowBytes = src.fWidth * sizeof(GPixel);
+    src.fPixels = srcStorage;
+
+    // the bitmap covers device pixels 2..4, so only pixel 3 reads an inner column; everything
+    // left of it reads column 0 and everything right of it reads column 2
+    const float localMatrix[6] = { 1, 0, 2, 0, 1, 0 };
+    MyShaderFromBitmap shader(src, localMatrix);
+    const float identity[6] = { 1, 0, 0, 0, 1, 0 };
+    shader.setContext(identity);
+
+    GPixel row[8];
+    MyShader::Run runs[MyShader::kMaxRuns];
+    int runCount = shader.shadeSpan(0, 0, 8, row, runs);
+    stats->expectEQ(runCount, 3, "span_runs_count");
+    if (runCount == 3) {
+        stats->expectEQ(runs[0].count, 3, "span_runs_head");
+        stats->expectEQ(runs[0].color, srcStorage[0], "span_runs_head_color");
+        stats->expectEQ(runs[1].count, 1, "span_runs_middle");
+        stats->expectEQ(row[3], srcStorage[1], "span_runs_middle_color");
+        stats->expectEQ(runs[2].count, 4, "span_runs_tail");
+        stats->expectEQ(runs[2].color, srcStorage[2], "span_runs_tail_color");
+    }
+}
+
+static void test_row_invariant_gradient(GTestStats* stats) {
+    const GPoint pts[2] = { GPoint::Make(0, 0), GPoint::Make(10, 0) };
+    const GColor colors[2] = { GColor::MakeARGB(1, 1, 0, 0), GColor::MakeARGB(1, 0, 0, 1) };
+    MyShaderFromLinearGradient shader(pts, colors);
+
+    // a horizontal gradient only varies with x, until the CTM rotates it
+    const float identity[6] = { 1, 0, 0, 0, 1, 0 };
+    shader.setContext(identity);
+    stats->expectTrue(shader.isRowInvariant(), "row_invariant_horizontal");
+
+    const float rotate90[6] = { 0, -1, 0, 1, 0, 0 };
+    shader.setContext(rotate90);
+    stats->expectFalse(shader.isRowInvariant(), "row_invariant_rotated");
+}
+
+static void invert_stage(const void*, GPixel pixels[], int count) {
+    for (int i = 0; i < count; ++i) {
+        unsigned a = GPixel_GetA(pixels[i]);
+        pixels[i] = GPixel_PackARGB(a, a - GPixel_GetR(pixels[i]), a - GPixel_GetG(pixels[i]),
+                                    a - GPixel_GetB(pixels[i]));
+    }
+}
+
+static void test_pipeline_stages(GTestStats* stats) {
+    GBitmap dst;
+    setup_bitmap(&dst, 4, 1);
+
+    // red, inverted by the stage to cyan, then scaled by coverage
+    const uint8_t coverage[4] = { 0, 64, 128, 255 };
+    MyPipeline pipeline(dst, GColor::MakeARGB(1, 1, 0, 0));
+    pipeline.addStage(invert_stage, NULL);
+    pipeline.run(0, 0, 4, coverage);
+
+    for (int x = 0; x < 4; ++x) {
+        unsigned c = coverage[x] + (coverage[x] >> 7);
+        unsigned v = 255 * c >> 8;
+        stats->expectEQ(*dst.getAddr(x, 0), GPixel_PackARGB(v, 0, v, v), "pipeline_stages");
+    }
+    free(dst.fPixels);
+}
+
+static void test_paint_alpha(GTestStats* stats) {
+    GBitmap dst;
+    setup_bitmap(&dst, 3, 1);
+    MyCanvas canvas(dst);
+    canvas.setAlpha(0.5f);
+
+    // a solid color, a shader and a stroke all come out at half their alpha (255 * 128 >> 8)
+    canvas.fillRect(GRect::MakeXYWH(0, 0, 1, 1), GColor::MakeARGB(1, 1, 0, 0));
+    GShader* shader = GShader::FromColor(GColor::MakeARGB(1, 0, 1, 0));
+    canvas.shadeRect(GRect::MakeXYWH(1, 0, 1, 1), shader);
+    GCanvas::Stroke stroke = { 1, 4, false };
+    canvas.strokeLine(GPoint::Make(2, 0.5f), GPoint::Make(3, 0.5f), stroke, GColor::MakeARGB(1, 0, 0, 1));
+
+    stats->expectEQ(*dst.getAddr(0, 0), GPixel_PackARGB(127, 127, 0, 0), "paint_alpha_color");
+    stats->expectEQ(*dst.getAddr(1, 0), GPixel_PackARGB(127, 0, 127, 0), "paint_alpha_shader");
+    stats->expectEQ(*dst.getAddr(2, 0), GPixel_PackARGB(127, 0, 0, 127), "paint_alpha_stroke");
+
+    // a copy of a pipeline keeps its alpha after the original is gone
+    MyPipeline* original = new MyPipeline(dst, shader, MyBlendMode::kSrc);
+    original->setAlpha(0.5f);
+    MyPipeline copy(*original);
+    delete original;
+    copy.run(0, 0, 1);
+    stats->expectEQ(*dst.getAddr(0, 0), GPixel_PackARGB(127, 0, 127, 0), "paint_alpha_copied_pipeline");
+    delete shader;
+    free(dst.fPixels);
+}
+
+static void test_compose_shader(GTestStats* stats) {
+    // a vignette-like gradient that is constant past x = 8, multiplied into a half gray
+    const GPoint pts[2] = { GPoint::Make(0, 0), GPoint::Make(8, 0) };
+    const GColor colors[2] = { GColor::MakeARGB(1, 1, 0.5f, 0), GColor::MakeARGB(0.5f, 0, 0, 1) };
+    MyShaderFromLinearGradient gradient(pts, colors);
+    const GColor grays[2] = { GColor::MakeARGB(1, 0.5f, 0.5f, 0.5f), GColor::MakeARGB(1, 0.5f, 0.5f, 0.5f) };
+    MyShaderFromLinearGradient gray(pts, grays);
+    MyShaderFromShaders compose(&gray, &gradient, MyBlendMode::kMultiply);
+
+    const float identity[6] = { 1, 0, 0, 0, 1, 0 };
+    stats->expectTrue(compose.setContext(identity), "compose_shader_context");
+
+    GPixel a[16], b[16], row[16];
+    gray.shadeRow(0, 0, 16, a);
+    gradient.shadeRow(0, 0, 16, b);
+    compose.shadeRow(0, 0, 16, row);
+    bool same = true;
+    for (int x = 0; x < 16; ++x) {
+        same &= row[x] == MyBlend_Pixel(MyBlendMode::kMultiply, b[x], a[x]);
+    }
+    stats->expectTrue(same, "compose_shader_row");
+
+    // the constant tail of both shaders comes back as one constant run
+    MyShader::Run runs[MyShader::kMaxRuns];
+    stats->expectEQ(compose.shadeSpan(10, 0, 6, row, runs), 1, "compose_shader_runs");
+    stats->expectTrue(runs[0].isConstant && runs[0].color == MyBlend_Pixel(MyBlendMode::kMultiply, b[15], a[15]),
+                      "compose_shader_constant");
+}
+
+static void test_color_matrix(GTestStats* stats) {
+    const float grayscale[20] = {
+        0.25f, 0.5f, 0.25f, 0, 0,
+        0.25f, 0.5f, 0.25f, 0, 0,
+        0.25f, 0.5f, 0.25f, 0, 0,
+        0,     0,    0,     1, 0,
+    };
+    const float fade[20] = { 1, 0, 0, 0, 0,   0, 1, 0, 0, 0,   0, 0, 1, 0, 0,   0, 0, 0, 0.5f, 0 };
+    MyColorMatrix gray(grayscale);
+    stats->expectTrue(!gray.isIdentity() && !gray.isAlphaOnly(), "color_matrix_general");
+    stats->expectTrue(MyColorMatrix(fade).isAlphaOnly(), "color_matrix_alpha_only");
+
+    GBitmap src, dst, expected;
+    setup_bitmap(&src, 19, 1);
+    setup_bitmap(&dst, 19, 1);
+    setup_bitmap(&expected, 19, 1);
+    for (int x = 0; x < 19; ++x) {
+        int a = x * 14;
+        *src.getAddr(x, 0) = GPixel_PackARGB(a, a * x / 18, a / 2, a * (18 - x) / 18);
+    }
+
+    // a whole span (vectorized where possible) matches filtering one pixel at a time
+    const float localMatrix[6] = { 1, 0, 0, 0, 1, 0 };
+    MyShaderFromBitmap shader(src, localMatrix);
+    shader.setContext(localMatrix);
+    MyPipeline pipeline(dst, &shader, MyBlendMode::kSrc);
+    gray.addStageTo(pipeline);
+    pipeline.run(0, 0, 19);
+    MyPipeline single(expected, &shader, MyBlendMode::kSrc);
+    gray.addStageTo(single);
+    for (int x = 0; x < 19; ++x) {
+        single.run(x, 0, 1);
+    }
+    stats->expectTrue(!memcmp(dst.fPixels, expected.fPixels, 19 * sizeof(GPixel)), "color_matrix_span");
+
+    // opaque green comes out as gray
+    MyCanvas canvas(dst);
+    canvas.setColorMatrix(&gray);
+    canvas.fillRect(GRect::MakeWH(1, 1), GColor::MakeARGB(1, 0, 1, 0));
+    stats->expectEQ(*dst.getAddr(0, 0), GPixel_PackARGB(255, 128, 128, 128), "color_matrix_canvas");
+
+    free(src.fPixels);
+    free(dst.fPixels);
+    free(expected.fPixels);
+}
+
+static void test_sweep_gradient(GTestStats* stats) {
+    // black along +x, turning clockwise to white
+    const GColor colors[2] = { GColor::MakeARGB(1, 0, 0, 0), GColor::MakeARGB(1, 1, 1, 1) };
+    MyShaderFromSweepGradient shader(GPoint::Make(10, 10), colors);
+    const float identity[6] = { 1, 0, 0, 0, 1, 0 };
+    shader.setContext(identity);
+
+    // every row of a 20x20 square stays within 1 of the exact angle, and a whole row (vectorized
+    // where possible) matches shading it one pixel at a time
+    bool close = true, same = true;
+    for (int y = 0; y < 20; ++y) {
+        GPixel row[20];
+        shader.shadeRow(0, y, 20, row);
+        for (int x = 0; x < 20; ++x) {
+            float turns = atan2f(y + 0.5f - 10, x + 0.5f - 10) / (2 * (float) M_PI);
+            int expected = (int) ((turns < 0 ? turns + 1 : turns) * 255 + 0.5f);
+            close &= abs(GPixel_GetG(row[x]) - expected) <= 1;
+
+            GPixel single;
+            shader.shadeRow(x, y, 1, &single);
+            same &= single == row[x];
+        }
+    }
+    stats->expectTrue(close, "sweep_gradient_angle");
+    stats->expectTrue(same, "sweep_gradient_span");
+
+    // over a bigger square, on both sides of every diagonal, each pixel picks the same entry as
+    // the exact angle, unless that lands within a hair of halfway between two entries
+    MyShaderFromSweepGradient big(GPoint::Make(32, 32), colors);
+    big.setContext(identity);
+    bool exact = true;
+    for (int y = 0; y < 64; ++y) {
+        GPixel row[64];
+        big.shadeRow(0, y, 64, row);
+        for (int x = 0; x < 64; ++x) {
+            double turns = atan2(y + 0.5 - 32, x + 0.5 - 32) / (2 * M_PI);
+            double entry = (turns < 0 ? turns + 1 : turns) * 255;
+            if (fabs(entry - floor(entry) - 0.5) > 0.02) {
+                exact &= GPixel_GetG(row[x]) == (int) (entry + 0.5);
+            }
+        }
+    }
+    stats->expectTrue(exact, "sweep_gradient_diagonals");
+}
+
+static void test_noise_shader(GTestStats* stats) {
+    const GColor colors[2] = { GColor::MakeARGB(1, 0, 0, 0), GColor::MakeARGB(1, 1, 1, 1) };
+    MyShaderFromNoise noise(colors, 0.1f, 4, 1234);
+    MyShaderFromNoise same(colors, 0.1f, 4, 1234);
+    MyShaderFromNoise other(colors, 0.1f, 4, 99);
+    const float ctm[6] = { 2, 0.5f, -3, -0.25f, 1.5f, 7 };
+    noise.setContext(ctm);
+    same.setContext(ctm);
+    other.setContext(ctm);
+
+    // a whole row (vectorized where possible) matches shading one pixel at a time, and the
+    // texture depends only on the seed
+    GPixel row[21], sameRow[21], otherRow[21];
+    bool single = true;
+    int lo = 255, hi = 0;
+    for (int y = 0; y < 16; ++y) {
+        noise.shadeRow(-5, y, 21, row);
+        for (int x = 0; x < 21; ++x) {
+            GPixel pixel;
+            noise.shadeRow(x - 5, y, 1, &pixel);
+            single &= pixel == row[x];
+            lo = std::min(lo, (int) GPixel_GetG(row[x]));
+            hi = std::max(hi, (int) GPixel_GetG(row[x]));
+        }
+    }
+    same.shadeRow(-5, 15, 21, sameRow);
+    other.shadeRow(-5, 15, 21, otherRow);
+    stats->expectTrue(single, "noise_span");
+    stats->expectTrue(!memcmp(row, sameRow, sizeof(row)), "noise_seed_same");
+    stats->expectTrue(memcmp(row, otherRow, sizeof(row)) != 0, "noise_seed_other");
+    stats->expectTrue(hi - lo > 32, "noise_varies");
+
+    // cells far outside the range of int wrap onto the lattice like any other: 2^32 is a whole
+    // number of lattices in every octave, so it shades like 0
+    MyShaderFromNoise unit(colors, 1, 4, 1234);
+    const float far[6] = { 1, 0, -4294967296.0f, 0, 1, 0 };
+    const float near[6] = { 1, 0, 0.5f, 0, 1, 0 };
+    GPixel farRow[9], nearPixel;
+    unit.setContext(far);
+    unit.shadeRow(0, 3, 9, farRow);
+    unit.setContext(near);
+    unit.shadeRow(0, 3, 1, &nearPixel);
+    bool wrapped = true;
+    for (int x = 0; x < 9; ++x) {
+        wrapped &= farRow[x] == nearPixel;
+    }
+    stats->expectTrue(wrapped, "noise_far");
+}
+
+static void test_shader_cache(GTestStats* stats) {
+    const GColor colors[2] = { GColor::MakeARGB(1, 1, 0, 0), GColor::MakeARGB(1, 0, 0, 1) };
+    MyShaderFromSweepGradient shader(GPoint::Make(8, 8), colors);
+    const GPoint quad[4] = { GPoint::Make(1, 0), GPoint::Make(15, 3), GPoint::Make(12, 16), GPoint::Make(0, 9) };
+
+    GBitmap direct, cached;
+    setup_bitmap(&direct, 16, 16);
+    setup_bitmap(&cached, 16, 16);
+    MyCanvas directCanvas(direct);
+    directCanvas.shadeConvexPolygon(quad, 4, &shader);
+    directCanvas.shadeRect(GRect::MakeXYWH(2, 2, 9, 9), &shader);
+
+    // the first draw bakes the shader; the rect inside the polygon's bounds reuses it
+    MyCanvas canvas(cached);
+    canvas.setShaderCaching(true);
+    int hits = MyShaderCache::HitCount();
+    int misses = MyShaderCache::MissCount();
+    canvas.shadeConvexPolygon(quad, 4, &shader);
+    canvas.shadeRect(GRect::MakeXYWH(2, 2, 9, 9), &shader);
+    stats->expectEQ(MyShaderCache::MissCount() - misses, 1, "shader_cache_miss");
+    stats->expectEQ(MyShaderCache::HitCount() - hits, 1, "shader_cache_hit");
+    stats->expectTrue(!memcmp(direct.fPixels, cached.fPixels, 16 * 16 * sizeof(GPixel)), "shader_cache_pixels");
+
+    // a new CTM, or a purged shader, bakes again
+    canvas.save();
+    canvas.translate(1, 0);
+    canvas.shadeRect(GRect::MakeXYWH(2, 2, 9, 9), &shader);
+    canvas.restore();
+    MyShaderCache::Purge(&shader);
+    canvas.shadeRect(GRect::MakeXYWH(2, 2, 9, 9), &shader);
+    stats->expectEQ(MyShaderCache::MissCount() - misses, 3, "shader_cache_rebake");
+
+    // far apart rects get entries of their own, so drawing them in turn keeps hitting both,
+    // even when a budget too small for their union can hold both
+    MyShaderCache::Purge(&shader);
+    MyShaderCache::SetCacheBudget(1000);
+    hits = MyShaderCache::HitCount();
+    misses = MyShaderCache::MissCount();
+    for (int i = 0; i < 2; ++i) {
+        canvas.shadeRect(GRect::MakeXYWH(0, 0, 2, 2), &shader);
+        canvas.shadeRect(GRect::MakeXYWH(14, 14, 2, 2), &shader);
+    }
+    MyShaderCache::SetCacheBudget(16 * 1024 * 1024);
+    stats->expectEQ(MyShaderCache::MissCount() - misses, 2, "shader_cache_far_apart_miss");
+    stats->expectEQ(MyShaderCache::HitCount() - hits, 2, "shader_cache_far_apart_hit");
+
+    // adjacent strips grow one entry, which then covers both with the same pixels
+    MyShaderCache::Purge(&shader);
+    directCanvas.shadeRect(GRect::MakeXYWH(0, 0, 16, 4), &shader);
+    directCanvas.shadeRect(GRect::MakeXYWH(0, 4, 16, 4), &shader);
+    canvas.shadeRect(GRect::MakeXYWH(0, 0, 16, 4), &shader);
+    canvas.shadeRect(GRect::MakeXYWH(0, 4, 16, 4), &shader);
+    hits = MyShaderCache::HitCount();
+    canvas.shadeRect(GRect::MakeXYWH(0, 0, 16, 8), &shader);
+    stats->expectEQ(MyShaderCache::HitCount() - hits, 1, "shader_cache_grown");
+    stats->expectTrue(!memcmp(direct.fPixels, cached.fPixels, 16 * 8 * sizeof(GPixel)), "shader_cache_grown_pixels");
+
+    // fillBitmapRect's shader is on the stack at the same address every call; a blue bitmap
+    // drawn after a red one must not reuse the red pixels
+    GPixel red = GPixel_PackARGB(0xFF, 0xFF, 0, 0);
+    GPixel blue = GPixel_PackARGB(0xFF, 0, 0, 0xFF);
+    GBitmap src;
+    src.fWidth = 1;
+    src.fHeight = 1;
+    src.fRowBytes = sizeof(GPixel);
+    src.fPixels = &red;
+    canvas.fillBitmapRect(src, GRect::MakeXYWH(0, 0, 4, 4));
+    src.fPixels = &blue;
+    canvas.fillBitmapRect(src, GRect::MakeXYWH(0, 0, 4, 4));
+    stats->expectEQ(*cached.getAddr(2, 2), blue, "shader_cache_bitmap_rect");
+
+    // nor may a shader built where a cached one was
+    for (int i = 0; i < 2; ++i) {
+        GPixel pixel = i ? blue : red;
+        src.fPixels = &pixel;
+        const float localMatrix[6] = { 4, 0, 0, 0, 4, 0 };
+        MyShaderFromBitmap bitmapShader(src, localMatrix);
+        canvas.shadeRect(GRect::MakeXYWH(0, 0, 4, 4), &bitmapShader);
+    }
+    stats->expectEQ(*cached.getAddr(2, 2), blue, "shader_cache_new_shader");
+
+    free(direct.fPixels);
+    free(cached.fPixels);
+}
+
+static void test_lowp_gradient(GTestStats* stats) {
+    const GPoint pts[2] = { GPoint::Make(0, 0), GPoint::Make(256, 0) };
+    const GColor colors[2] = { GColor::MakeARGB(1, 0, 0, 0), GColor::MakeARGB(1, 1, 1, 1) };
+    MyShaderFromLinearGradient shader(pts, colors);
+    const float identity[6] = { 1, 0, 0, 0, 1, 0 };
+    shader.setContext(identity);
+
+    // equal alphas take the 16 bit path, which must stay within 1 of the exact ramp
+    GPixel row[256];
+    shader.shadeRow(0, 0, 256, row);
+    bool close = true;
+    for (int x = 0; x < 256; ++x) {
+        int expected = (int) ((x + 0.5f) / 256 * 255 + 0.5f);
+        close &= GPixel_GetA(row[x]) == 255 && abs(GPixel_GetG(row[x]) - expected) <= 1;
+    }
+    stats->expectTrue(close, "lowp_gradient");
+}
+
+static bool is_filled_with_or_clear(const GBitmap& bitmap, GPixel pixel) {
+    for (int y = 0; y < bitmap.height(); ++y) {
+        for (int x = 0; x < bitmap.width(); ++x) {
+            GPixel p = *bitmap.getAddr(x, y);
+            if (p != 0 && p != pixel) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static void test_stroke_overlap(GTestStats* stats) {
+    GBitmap dst;
+    setup_bitmap(&dst, 16, 16);
+    MyCanvas canvas(dst);
+
+    // translucent strokes must not blend twice where their pieces overlap: at the joins of a
+    // zig-zag, and where the last side of a square meets its first
+    const GColor color = GColor::MakeARGB(0.5f, 1, 0, 0);
+    const GPixel once = GPixel_PackARGB(127, 127, 0, 0);
+    GCanvas::Stroke stroke = { 3, 4, true };
+    const GPoint zigzag[] = { GPoint::Make(2, 2), GPoint::Make(6, 8), GPoint::Make(10, 2), GPoint::Make(13, 13) };
+    canvas.strokePolygon(zigzag, 4, false, stroke, color);
+    stats->expectTrue(is_filled_with_or_clear(dst, once), "stroke_overlap_joins");
+
+    clear(dst);
+    canvas.strokeRect(GRect::MakeLTRB(4, 4, 12, 12), stroke, color);
+    stats->expectTrue(is_filled_with_or_clear(dst, once), "stroke_overlap_closed");
+    stats->expectEQ(*dst.getAddr(4, 4), once, "stroke_overlap_corner");
+    free(dst.fPixels);
+}
+
+static void test_round_strokes(GTestStats* stats) {
+    GBitmap dst;
+    setup_bitmap(&dst, 32, 32);
+    MyCanvas canvas(dst);
+    canvas.setStrokeStyle(MyStroker::kRoundJoin, MyStroker::kRoundCap);
+
+    // an L of radius 4 from (8, 8) to (24, 8) to (24, 24): the cap and the outer corner are
+    // round, so the pixels at the corners of a square cap or a miter stay empty
+    const GPixel red = GPixel_PackARGB(0xFF, 0xFF, 0, 0);
+    const GPoint pts[] = { GPoint::Make(8, 8), GPoint::Make(24, 8), GPoint::Make(24, 24) };
+    GCanvas::Stroke stroke = { 8, 4, true };
+    canvas.strokePolygon(pts, 3, false, stroke, GColor::MakeARGB(1, 1, 0, 0));
+
+    stats->expectEQ(*dst.getAddr(4, 8), red, "round_strokes_cap");
+    stats->expectEQ(*dst.getAddr(4, 4), (GPixel) 0, "round_strokes_cap_corner");
+    stats->expectEQ(*dst.getAddr(26, 5), red, "round_strokes_join");
+    stats->expectEQ(*dst.getAddr(27, 4), (GPixel) 0, "round_strokes_join_corner");
+    stats->expectEQ(*dst.getAddr(24, 27), red, "round_strokes_end_cap");
+    stats->expectEQ(*dst.getAddr(27, 27), (GPixel) 0, "round_strokes_end_cap_corner");
+    free(dst.fPixels);
+}
+
+static void test_hairlines(GTestStats* stats) {
+    GBitmap dst;
+    setup_bitmap(&dst, 8, 4);
+    MyCanvas canvas(dst);
+    const GColor color = GColor::MakeARGB(1, 1, 0, 0);
+    GCanvas::Stroke stroke = { 1, 4, false };
+
+    // one pixel per step, from the start up to but not including the end
+    canvas.strokeLine(GPoint::Make(0.5f, 1.5f), GPoint::Make(7.5f, 1.5f), stroke, color);
+    bool row = true;
+    for (int x = 0; x < 8; ++x) {
+        row &= *dst.getAddr(x, 1) == (x < 7 ? GPixel_PackARGB(0xFF, 0xFF, 0, 0) : 0);
+        row &= *dst.getAddr(x, 0) == 0 && *dst.getAddr(x, 2) == 0;
+    }
+    stats->expectTrue(row, "hairlines_aliased");
+
+    // antialiased, a line between two rows of centers is split evenly between them
+    clear(dst);
+    canvas.setHairlineAntiAlias(true);
+    canvas.strokeLine(GPoint::Make(0.5f, 2), GPoint::Make(7.5f, 2), stroke, color);
+    int above = GPixel_GetA(*dst.getAddr(3, 1));
+    int below = GPixel_GetA(*dst.getAddr(3, 2));
+    stats->expectTrue(abs(above - below) <= 2 && abs(above + below - 255) <= 2, "hairlines_antialiased");
+
+    // a line starting far off the device still draws the part on it
+    clear(dst);
+    canvas.setHairlineAntiAlias(false);
+    canvas.strokeLine(GPoint::Make(-20000, 2.5f), GPoint::Make(60, 2.5f), stroke, color);
+    row = true;
+    for (int x = 0; x < 8; ++x) {
+        row &= *dst.getAddr(x, 2) == GPixel_PackARGB(0xFF, 0xFF, 0, 0);
+    }
+    stats->expectTrue(row, "hairlines_clipped");
+
+    // lines written straight into the pixels match the same lines run through a pipeline
+    clear(dst);
+    GBitmap expected;
+    setup_bitmap(&expected, 8, 4);
+    MyCanvas expectedCanvas(expected);
+    const GPoint pts[2] = { GPoint::Make(0.2f, 3.7f), GPoint::Make(7.9f, 0.1f) };
+    const MyBlendMode modes[] = { MyBlendMode::kSrcOver, MyBlendMode::kSrc };
+    const GColor colors[] = { GColor::MakeARGB(1, 0, 1, 0), GColor::MakeARGB(0.5f, 0, 0, 1) };
+    for (int i = 0; i < 2; ++i) {
+        canvas.setBlendMode(modes[i]);
+        expectedCanvas.setBlendMode(modes[i]);
+        canvas.strokeLine(pts[0], pts[1], stroke, colors[i]);
+        expectedCanvas.strokePolygon(pts, 2, false, stroke, colors[i]);
+    }
+    stats->expectTrue(!memcmp(dst.fPixels, expected.fPixels, 8 * 4 * sizeof(GPixel)), "hairlines_solid");
+    free(expected.fPixels);
+    free(dst.fPixels);
+}
+
+static bool is_row_dashed(const GBitmap& bitmap, int y, const char* pattern) {
+    for (int x = 0; pattern[x]; ++x) {
+        if ((*bitmap.getAddr(x, y) != 0) != (pattern[x] == '-')) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void test_dashes(GTestStats* stats) {
+    GBitmap dst;
+    setup_bitmap(&dst, 32, 8);
+    MyCanvas canvas(dst);
+    const GColor color = GColor::MakeARGB(1, 0, 0, 1);
+    const float intervals[] = { 4, 4 };
+    GCanvas::Stroke stroke = { 2, 4, false };
+
+    canvas.setDash(intervals, 2, 2);
+    canvas.strokeLine(GPoint::Make(0, 4), GPoint::Make(24, 4), stroke, color);
+    stats->expectTrue(is_row_dashed(dst, 4, "--    ----    ----    --      "), "dashes_phase");
+
+    // zero length dashes are just their (round) caps: dots
+    clear(dst);
+    const float dots[] = { 0, 8 };
+    canvas.setDash(dots, 2, 0);
+    canvas.setStrokeStyle(MyStroker::kMiterJoin, MyStroker::kRoundCap);
+    GCanvas::Stroke dotted = { 4, 4, true };
+    canvas.strokeLine(GPoint::Make(4, 4), GPoint::Make(28, 4), dotted, color);
+    stats->expectTrue(is_row_dashed(dst, 4, "  ----    ----    ----    ----  "), "dashes_dots");
+
+    // hairlines are dashed too
+    clear(dst);
+    canvas.setDash(intervals, 2, 0);
+    GCanvas::Stroke hairline = { 1, 4, false };
+    canvas.strokeLine(GPoint::Make(0, 4.5f), GPoint::Make(16, 4.5f), hairline, color);
+    stats->expectTrue(is_row_dashed(dst, 4, "----    ----                    "), "dashes_hairline");
+
+    // an invalid pattern turns dashing off
+    clear(dst);
+    canvas.setDash(intervals, 1, 0);
+    canvas.strokeLine(GPoint::Make(0, 4.5f), GPoint::Make(16, 4.5f), hairline, color);
+    stats->expectTrue(is_row_dashed(dst, 4, "----------------                "), "dashes_off");
+
+    // dashes along segments far longer than the device are still found where they land
+    clear(dst);
+    canvas.setDash(intervals, 2, 0);
+    canvas.strokeLine(GPoint::Make(0, 4.5f), GPoint::Make(3e7f, 4.5f), hairline, color);
+    stats->expectTrue(is_row_dashed(dst, 4, "----    ----    ----    ----    "), "dashes_long_hairline");
+    clear(dst);
+    canvas.strokeLine(GPoint::Make(-3e7f, 4), GPoint::Make(32, 4), stroke, color);
+    stats->expectTrue(is_row_dashed(dst, 4, "----    ----    ----    ----    "), "dashes_long_stroke");
+    free(dst.fPixels);
+}
+
+static void test_path(GTestStats* stats) {
+    GBitmap dst;
+    setup_bitmap(&dst, 32, 32);
+    MyCanvas canvas(dst);
+    const GPixel blue = GPixel_PackARGB(0xFF, 0, 0, 0xFF);
+
+    // a circle of radius 12 from four cubics, with a square hole wound the other way
+    const float k = 12 * 0.5523f;
+    MyPath path;
+    path.moveTo(28, 16);
+    path.cubicTo(GPoint::Make(28, 16 + k), GPoint::Make(16 + k, 28), GPoint::Make(16, 28));
+    path.cubicTo(GPoint::Make(16 - k, 28), GPoint::Make(4, 16 + k), GPoint::Make(4, 16));
+    path.cubicTo(GPoint::Make(4, 16 - k), GPoint::Make(16 - k, 4), GPoint::Make(16, 4));
+    path.cubicTo(GPoint::Make(16 + k, 4), GPoint::Make(28, 16 - k), GPoint::Make(28, 16));
+    path.close();
+    path.moveTo(14, 14).lineTo(14, 18).lineTo(18, 18).lineTo(18, 14).close();
+    canvas.fillPath(path, GColor::MakeARGB(1, 0, 0, 1));
+
+    // pixels whose centers are inside the circle (and outside the hole) are filled
+    bool round = true;
+    for (int y = 0; y < 32; ++y) {
+        for (int x = 0; x < 32; ++x) {
+            float dx = x + 0.5f - 16, dy = y + 0.5f - 16;
+            float d = sqrtf(dx * dx + dy * dy);
+            bool hole = x >= 14 && x < 18 && y >= 14 && y < 18;
+            if (d < 11.8f || d > 12.2f) {
+                round &= *dst.getAddr(x, y) == (d < 12 && !hole ? blue : 0);
+            }
+        }
+    }
+    stats->expectTrue(round, "path_cubics");
+
+    // a quad whose segment count is picked in device space still fills up to the curve
+    clear(dst);
+    MyPath quad;
+    quad.moveTo(0, 0).quadTo(GPoint::Make(4, 8), GPoint::Make(8, 0));
+    const float scale[6] = { 4, 0, 0, 0, 4, 0 };
+    canvas.concat(scale);
+    canvas.fillPath(quad, GColor::MakeARGB(1, 0, 0, 1));
+    stats->expectEQ(*dst.getAddr(16, 14), blue, "path_quad_inside");
+    stats->expectEQ(*dst.getAddr(16, 16), (GPixel) 0, "path_quad_outside");
+    free(dst.fPixels);
+}
+
+// Pixels whose centers are inside the ellipse at (cx, cy) with radii rx, ry are color, others are
+// clear; those within 2% of the edge may be either
+static bool is_oval(const GBitmap& bitmap, float cx, float cy, float rx, float ry, GPixel color) {
+    for (int y = 0; y < bitmap.height(); ++y) {
+        for (int x = 0; x < bitmap.width(); ++x) {
+            float dx = (x + 0.5f - cx) / rx, dy = (y + 0.5f - cy) / ry;
+            float d = sqrtf(dx * dx + dy * dy);
+            if ((d < 0.98f && *bitmap.getAddr(x, y) != color) || (d > 1.02f && *bitmap.getAddr(x, y) != 0)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static void test_ovals(GTestStats* stats) {
+    GBitmap dst;
+    setup_bitmap(&dst, 32, 32);
+    MyCanvas canvas(dst);
+    const GColor color = GColor::MakeARGB(1, 0, 1, 0);
+    const GPixel green = GPixel_PackARGB(0xFF, 0, 0xFF, 0);
+
+    canvas.fillOval(GRect::MakeLTRB(2, 8, 30, 24), color);
+    stats->expectTrue(is_oval(dst, 16, 16, 14, 8, green), "ovals_analytic");
+
+    // rotated a quarter turn about the center, it goes through the path instead
+    clear(dst);
+    const float rotate[6] = { 0, -1, 32, 1, 0, 0 };
+    canvas.save();
+    canvas.concat(rotate);
+    canvas.fillOval(GRect::MakeLTRB(2, 8, 30, 24), color);
+    canvas.restore();
+    stats->expectTrue(is_oval(dst, 16, 16, 8, 14, green), "ovals_rotated");
+
+    clear(dst);
+    GShader* shader = GShader::FromColor(color);
+    canvas.shadeOval(GRect::MakeLTRB(8, 2, 24, 30), shader);
+    delete shader;
+    stats->expectTrue(is_oval(dst, 16, 16, 8, 14, green), "ovals_shaded");
+    free(dst.fPixels);
+}
+
+static void test_rrects(GTestStats* stats) {
+    GBitmap dst;
+    setup_bitmap(&dst, 32, 32);
+    MyCanvas canvas(dst);
+    const GPixel red = GPixel_PackARGB(0xFF, 0xFF, 0, 0);
+
+    const float radii[4] = { 8, 0, 4, 0 };
+    canvas.fillRRect(GRect::MakeLTRB(4, 4, 28, 28), radii, GColor::MakeARGB(1, 1, 0, 0));
+    stats->expectEQ(*dst.getAddr(4, 4), (GPixel) 0, "rrects_round_corner");
+    stats->expectEQ(*dst.getAddr(6, 6), red, "rrects_round_corner_inside");
+    stats->expectEQ(*dst.getAddr(27, 4), red, "rrects_square_corner");
+    stats->expectEQ(*dst.getAddr(27, 27), (GPixel) 0, "rrects_small_corner");
+    stats->expectEQ(*dst.getAddr(16, 16), red, "rrects_middle");
+
+    // a translucent stroke covers each pixel once, and leaves the inside alone
+    clear(dst);
+    const float round[4] = { 6, 6, 6, 6 };
+    GCanvas::Stroke stroke = { 4, 4, false };
+    canvas.strokeRRect(GRect::MakeLTRB(4, 4, 28, 28), round, stroke, GColor::MakeARGB(0.5f, 1, 0, 0));
+    const GPixel once = GPixel_PackARGB(127, 127, 0, 0);
+    stats->expectTrue(is_filled_with_or_clear(dst, once), "rrects_stroke_once");
+    stats->expectEQ(*dst.getAddr(4, 16), once, "rrects_stroke_side");
+    stats->expectEQ(*dst.getAddr(16, 16), (GPixel) 0, "rrects_stroke_inside");
+    stats->expectEQ(*dst.getAddr(2, 2), (GPixel) 0, "rrects_stroke_corner");
+    free(dst.fPixels);
+}
+
+static void test_polygon_batch(GTestStats* stats) {
+    GBitmap batched, separate;
+    setup_bitmap(&batched, 32, 32);
+    setup_bitmap(&separate, 32, 32);
+
+    // overlapping translucent triangles and a quad, batched and one at a time
+    const GPoint pts[] = {
+        GPoint::Make(2, 2), GPoint::Make(30, 6), GPoint::Make(8, 28),
+        GPoint::Make(28, 2), GPoint::Make(24, 30), GPoint::Make(3, 12),
+        GPoint::Make(10, 10), GPoint::Make(22, 11), GPoint::Make(21, 23), GPoint::Make(9, 20),
+    };
+    const int counts[] = { 3, 3, 4 };
+    const GColor colors[] = {
+        GColor::MakeARGB(0.5f, 1, 0, 0), GColor::MakeARGB(0.5f, 0, 1, 0), GColor::MakeARGB(0.75f, 0, 0, 1),
+    };
+    MyCanvas canvas(batched);
+    canvas.fillConvexPolygons(pts, counts, 3, colors);
+
+    MyCanvas reference(separate);
+    for (int i = 0, start = 0; i < 3; start += counts[i++]) {
+        MyPath path;
+        path.moveTo(pts[start]);
+        for (int j = 1; j < counts[i]; ++j) {
+            path.lineTo(pts[start + j]);
+        }
+        reference.fillPath(path, colors[i]);
+    }
+    stats->expectTrue(memcmp(batched.pixels(), separate.pixels(), 32 * 32 * sizeof(GPixel)) == 0, "polygon_batch");
+    free(batched.fPixels);
+    free(separate.fPixels);
+}
+
+static void test_vertices(GTestStats* stats) {
+    GBitmap dst, reference;
+    setup_bitmap(&dst, 32, 32);
+    setup_bitmap(&reference, 32, 32);
+    MyCanvas canvas(dst);
+
+    // a translucent red to blue strip of two triangles covers every pixel exactly once
+    const GPoint quad[4] = { GPoint::Make(0, 0), GPoint::Make(0, 32), GPoint::Make(32, 0), GPoint::Make(32, 32) };
+    const GColor red = GColor::MakeARGB(0.5f, 1, 0, 0);
+    const GColor blue = GColor::MakeARGB(0.5f, 0, 0, 1);
+    const GColor colors[4] = { red, red, blue, blue };
+    canvas.drawVertices(MyCanvas::kTriangleStrip, 4, quad, colors, NULL, NULL);
+    bool once = true;
+    for (int y = 0; y < 32; ++y) {
+        for (int x = 0; x < 32; ++x) {
+            once = once && GPixel_GetA(*dst.getAddr(x, y)) == 0x80;
+        }
+    }
+    stats->expectTrue(once, "vertices_strip_seam");
+    stats->expectTrue(GPixel_GetR(*dst.getAddr(1, 20)) > 0x70 && GPixel_GetB(*dst.getAddr(1, 20)) < 0x10, "vertices_color_left");
+    stats->expectTrue(GPixel_GetB(*dst.getAddr(30, 5)) > 0x70 && GPixel_GetR(*dst.getAddr(30, 5)) < 0x10, "vertices_color_right");
+
+    // a bitmap mapped onto a fan under a scale matches shading the same rect
+    GPixel srcStorage[4] = {
+        GPixel_PackARGB(0xFF, 0xFF, 0, 0), GPixel_PackARGB(0xFF, 0, 0xFF, 0),
+        GPixel_PackARGB(0xFF, 0, 0, 0xFF), GPixel_PackARGB(0x80, 0x80, 0x80, 0),
+    };
+    GBitmap src;
+    src.fWidth = 2;
+    src.fHeight = 2;
+    src.fRowBytes = src.fWidth * sizeof(GPixel);
+    src.fPixels = srcStorage;
+    const float localMatrix[6] = { 4, 0, 0, 0, 4, 0 };
+    MyShaderFromBitmap shader(src, localMatrix);
+    const float scale[6] = { 2, 0, 0, 0, 2, 0 };
+
+    clear(dst);
+    const GPoint fan[4] = { GPoint::Make(0, 0), GPoint::Make(8, 0), GPoint::Make(8, 8), GPoint::Make(0, 8) };
+    canvas.save();
+    canvas.concat(scale);
+    canvas.drawVertices(MyCanvas::kTriangleFan, 4, fan, NULL, NULL, &shader);
+    canvas.restore();
+
+    MyCanvas referenceCanvas(reference);
+    referenceCanvas.concat(scale);
+    referenceCanvas.shadeRect(GRect::MakeWH(8, 8), &shader);
+    stats->expectTrue(memcmp(dst.pixels(), reference.pixels(), 32 * 32 * sizeof(GPixel)) == 0, "vertices_texture");
+
+    // opaque white vertex colors leave the texture as it is
+    clear(dst);
+    const GColor white = GColor::MakeARGB(1, 1, 1, 1);
+    const GColor whites[6] = { white, white, white, white, white, white };
+    const GPoint triangles[6] = { fan[0], fan[1], fan[2], fan[0], fan[2], fan[3] };
+    canvas.concat(scale);
+    canvas.drawVertices(MyCanvas::kTriangles, 6, triangles, whites, NULL, &shader);
+    stats->expectTrue(memcmp(dst.pixels(), reference.pixels(), 32 * 32 * sizeof(GPixel)) == 0, "vertices_modulate");
+    free(dst.fPixels);
+    free(reference.fPixels);
+}
+
+static void test_blend_modes(GTestStats* stats) {
+    GBitmap dst;
+    setup_bitmap(&dst, 1, 1);
+    MyCanvas canvas(dst);
+
+    // half transparent red over opaque blue
+    const GColor src = GColor::MakeARGB(128 / 255.0f, 1, 0, 0);
+    const GPixel blue = GPixel_PackARGB(0xFF, 0, 0, 0xFF);
+    const struct {
+        MyBlendMode mode;
+        GPixel expected;
+    } recs[] = {
+        { MyBlendMode::kClear,    0 },
+        { MyBlendMode::kSrc,      GPixel_PackARGB(128, 128, 0, 0) },
+        { MyBlendMode::kDst,      blue },
+        { MyBlendMode::kDstIn,    GPixel_PackARGB(128, 0, 0, 128) },
+        { MyBlendMode::kDstOut,   GPixel_PackARGB(127, 0, 0, 127) },
+        { MyBlendMode::kXor,      GPixel_PackARGB(127, 0, 0, 127) },
+        { MyBlendMode::kMultiply, GPixel_PackARGB(255, 0, 0, 127) },
+        { MyBlendMode::kScreen,   GPixel_PackARGB(255, 128, 0, 255) },
+    };
+    for (int i = 0; i < GARRAY_COUNT(recs); ++i) {
+        *dst.getAddr(0, 0) = blue;
+        canvas.setBlendMode(recs[i].mode);
+        canvas.fillRect(GRect::MakeWH(1, 1), src);
+        stats->expectEQ(*dst.getAddr(0, 0), recs[i].expected, "blend_modes");
+    }
+    free(dst.fPixels);
+}
+
+static void test_blend_row_kernels(GTestStats* stats) {
+    // the row kernels (vectorized when possible) must match blending pixel by pixel
+    const int count = 37;
+    GPixel src[count], dst[count], expected[count];
+    unsigned seed = 1;
+    for (int i = 0; i < count; ++i) {
+        GPixel p[2];
+        for (int j = 0; j < 2; ++j) {
+            seed = seed * 1103515245 + 12345;
+            unsigned a = (i % 5 == 0) ? 255 * j : (seed >> 8) & 0xFF;
+            p[j] = GPixel_PackARGB(a, (seed >> 16) % (a + 1), (seed >> 4) % (a + 1), (seed >> 20) % (a + 1));
+        }
+        src[i] = p[0];
+        dst[i] = p[1];
+    }
+
+    for (int m = 0; m <= (int) MyBlendMode::kLastMode; ++m) {
+        MyBlendMode mode = (MyBlendMode) m;
+        GPixel row[count];
+        memcpy(row, dst, sizeof(dst));
+        MyBlend_RowProc(mode)(row, src, count);
+        for (int i = 0; i < count; ++i) {
+            expected[i] = MyBlend_Pixel(mode, src[i], dst[i]);
+        }
+        stats->expectEQ(memcmp(row, expected, sizeof(row)), 0, "blend_row_kernels");
+    }
+}
+
+static void test_mipmap_bitmap(GTestStats* stats) {
+    // black and white checkerboard
+    GPixel srcStorage[16];
+    for (int i = 0; i < 16; ++i) {
+        srcStorage[i] = ((i ^ (i >> 2)) & 1) ? GPixel_PackARGB(0xFF, 0xFF, 0xFF, 0xFF)
+                                             : GPixel_PackARGB(0xFF, 0, 0, 0);
+    }
+    GBitmap src;
+    src.fWidth = src.fHeight = 4;
+    src.fRowBytes = src.fWidth * sizeof(GPixel);
+    src.fPixels = srcStorage;
+
+    GPixel dstStorage[1];
+    GBitmap dst;
+    dst.fWidth = dst.fHeight = 1;
+    dst.fRowBytes = dst.fWidth * sizeof(GPixel);
+    dst.fPixels = dstStorage;
+    memset(dst.fPixels, 0, sizeof(dstStorage));
+
+    // shrinking the whole checkerboard into one pixel should average it to grey
+    MyCanvas canvas(dst);
+    canvas.setFilterQuality(MyShaderFromBitmap::kMipmap);
+    canvas.fillBitmapRect(src, GRect::MakeWH(1, 1));
+    stats->expectEQ(*dst.getAddr(0, 0), GPixel_PackARGB(0xFF, 128, 128, 128), "mipmap_bitmap");
+
+    // drawing into the bitmap with a canvas replaces its cached levels
+    MyCanvas srcCanvas(src);
+    srcCanvas.fillRect(GRect::MakeXYWH(0, 0, 4, 2), GColor::MakeARGB(1, 1, 1, 1));
+    canvas.fillBitmapRect(src, GRect::MakeWH(1, 1));
+    stats->expectEQ(*dst.getAddr(0, 0), GPixel_PackARGB(0xFF, 192, 192, 192), "mipmap_bitmap_drawn_into");
+
+    // pixels written directly need a Purge
+    std::fill_n(srcStorage, 16, GPixel_PackARGB(0xFF, 0, 0, 0));
+    MyMipmap::Purge(src);
+    canvas.fillBitmapRect(src, GRect::MakeWH(1, 1));
+    stats->expectEQ(*dst.getAddr(0, 0), GPixel_PackARGB(0xFF, 0, 0, 0), "mipmap_bitmap_purged");
+
+    // a new bitmap over the same (say freed and reused) pixels gets its own levels
+    std::fill_n(srcStorage, 16, GPixel_PackARGB(0xFF, 0xFF, 0xFF, 0xFF));
+    GBitmap reused = src;
+    canvas.fillBitmapRect(reused, GRect::MakeWH(1, 1));
+    stats->expectEQ(*dst.getAddr(0, 0), GPixel_PackARGB(0xFF, 0xFF, 0xFF, 0xFF), "mipmap_bitmap_reused");
+}
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 
 static bool is_filled_with(const GBitmap& bitmap, GPixel expected) {
@@ -361,6 +1353,32 @@ const GTestRec gTestRecs[] = {
     { test_hori_bitmap, "hori_bitmap" },
     { test_vert_bitmap, "vert_bitmap" },
     { test_shrink_bitmap, "shrink_bitmap" },
+    { test_rotate_bitmap, "rotate_bitmap" },
+    { test_bilinear_bitmap, "bilinear_bitmap" },
+    { test_mipmap_bitmap, "mipmap_bitmap" },
+    { test_tiled_bitmap, "tiled_bitmap" },
+    { test_wide_mirrored_bitmap, "wide_mirrored_bitmap" },
+    { test_clamped_span_runs, "clamped_span_runs" },
+    { test_row_invariant_gradient, "row_invariant_gradient" },
+    { test_pipeline_stages, "pipeline_stages" },
+    { test_paint_alpha, "paint_alpha" },
+    { test_compose_shader, "compose_shader" },
+    { test_color_matrix, "color_matrix" },
+    { test_sweep_gradient, "sweep_gradient" },
+    { test_noise_shader, "noise_shader" },
+    { test_shader_cache, "shader_cache" },
+    { test_lowp_gradient, "lowp_gradient" },
+    { test_stroke_overlap, "stroke_overlap" },
+    { test_round_strokes, "round_strokes" },
+    { test_hairlines, "hairlines" },
+    { test_dashes, "dashes" },
+    { test_path, "path" },
+    { test_ovals, "ovals" },
+    { test_rrects, "rrects" },
+    { test_polygon_batch, "polygon_batch" },
+    { test_vertices, "vertices" },
+    { test_blend_modes, "blend_modes" },
+    { test_blend_row_kernels, "blend_row_kernels" },
 
     { test_bad_input_poly, "poly_bad_input" },
     { test_offscreen_poly, "poly_offscreen" },